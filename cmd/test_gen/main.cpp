@@ -116,7 +116,7 @@ generate_hash_ratchet()
       for (uint32_t k = 0; k < tv.n_generations; ++k) {
         auto key_nonce = ratchet.get(k);
         tc.key_sequences.at(j).steps.push_back(
-          { key_nonce.key, key_nonce.nonce });
+          { bytes(key_nonce.key), bytes(key_nonce.nonce) });
       }
     }
 
@@ -171,25 +171,25 @@ generate_key_schedule()
         std::vector<KeyScheduleTestVectors::KeyAndNonce>();
       for (LeafIndex k{ 0 }; k.val < n_members; ++k.val) {
         auto hs = epoch.handshake_keys.get(k, tv.target_generation);
-        handshake_keys.push_back({ hs.key, hs.nonce });
+        handshake_keys.push_back({ bytes(hs.key), bytes(hs.nonce) });
 
         auto app = epoch.application_keys.get(k, tv.target_generation);
-        application_keys.push_back({ app.key, app.nonce });
+        application_keys.push_back({ bytes(app.key), bytes(app.nonce) });
       }
 
       tc.epochs.push_back({
         LeafCount{ n_members },
         update_secret,
-        epoch.epoch_secret,
-        epoch.sender_data_secret,
-        epoch.sender_data_key,
-        epoch.handshake_secret,
+        bytes(epoch.epoch_secret),
+        bytes(epoch.sender_data_secret),
+        bytes(epoch.sender_data_key),
+        bytes(epoch.handshake_secret),
         handshake_keys,
-        epoch.application_secret,
+        bytes(epoch.application_secret),
         application_keys,
-        epoch.exporter_secret,
-        epoch.confirmation_key,
-        epoch.init_secret,
+        bytes(epoch.exporter_secret),
+        bytes(epoch.confirmation_key),
+        bytes(epoch.init_secret),
       });
 
       for (auto& val : update_secret) {
@@ -86,6 +86,13 @@ class Credential
 public:
   CredentialType type() const;
   SignaturePublicKey public_key() const;
+
+  // The identity of a basic credential.  For an X.509 credential this is the
+  // whole DER encoding of the leaf certificate, not its subject or a SAN, so
+  // two X.509 credentials have the same identity only if they carry the same
+  // leaf certificate.
+  const bytes& identity() const;
+
   bool valid_for(const SignaturePrivateKey& priv) const;
 
   template<typename T>
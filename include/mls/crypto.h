@@ -7,10 +7,48 @@
 #include <mls/common.h>
 #include <tls/tls_syntax.h>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
 namespace mls {
 
+/// Key derivation labels
+
+// A label for expand_with_label, together with its part of the HKDFLabel
+// encoding: "mls10 " and the label, behind a one-byte length.  The labels
+// used by the protocol are encoded once, as the constants below.  Labels
+// convert implicitly from strings and string literals, so callers can still
+// pass "label" to expand_with_label and derive_secret.
+class KDFLabel
+{
+public:
+  KDFLabel(const std::string& label);
+  KDFLabel(const char* label);
+
+  const bytes& encoded() const { return _encoded; }
+
+  static const KDFLabel app_key;
+  static const KDFLabel app_nonce;
+  static const KDFLabel app_secret;
+  static const KDFLabel hs_secret;
+  static const KDFLabel tree;
+  static const KDFLabel path;
+  static const KDFLabel sender_data;
+  static const KDFLabel sd_key;
+  static const KDFLabel handshake;
+  static const KDFLabel app;
+  static const KDFLabel exporter;
+  static const KDFLabel confirm;
+  static const KDFLabel init;
+  static const KDFLabel group_info;
+  static const KDFLabel key;
+  static const KDFLabel nonce;
+
+private:
+  bytes _encoded;
+};
+
 /// Cipher suites
 
 struct CipherSuite
@@ -38,13 +76,18 @@ struct CipherSuite
   const Ciphers& get() const;
 
   bytes expand_with_label(const bytes& secret,
-                          const std::string& label,
+                          const KDFLabel& label,
                           const bytes& context,
                           size_t length) const;
   bytes derive_secret(const bytes& secret,
-                      const std::string& label,
+                      const KDFLabel& label,
                       const bytes& context) const;
 
+  // Derivations from a single secret that share its HMAC key setup
+  class Expander;
+  Expander expander(const bytes& secret) const;
+  Expander expander(const secret_bytes& secret) const;
+
   TLS_SERIALIZABLE(id)
 
 private:
@@ -52,14 +95,148 @@ private:
   static const Ciphers ciphers;
 };
 
-extern const std::array<CipherSuite::ID, 6> all_supported_suites;
+class CipherSuite::Expander
+{
+public:
+  bytes expand_with_label(const KDFLabel& label,
+                          const bytes& context,
+                          size_t length) const;
+  bytes expand_with_label(const KDFLabel& label,
+                          const uint8_t* context,
+                          size_t context_size,
+                          size_t length) const;
+  bytes derive_secret(const KDFLabel& label, const bytes& context) const;
 
-// Utilities
-using hpke::random_bytes;
+  // Writes a derived secret, such as a message key, in place
+  void expand_with_label(const KDFLabel& label,
+                         const uint8_t* context,
+                         size_t context_size,
+                         size_t length,
+                         secret_bytes& out) const;
+
+private:
+  CipherSuite _suite;
+  std::shared_ptr<const hpke::KDF::Expander> _prk;
+
+  Expander(CipherSuite suite, std::unique_ptr<hpke::KDF::Expander> prk);
+  friend struct CipherSuite;
+};
+
+// A hash over TLS-encoded values, computed as the values are written to
+// stream(), without materializing the encoding
+class HashStream : public tls::ostream::sink
+{
+public:
+  explicit HashStream(CipherSuite suite);
+  HashStream(const HashStream& other) = delete;
+  HashStream& operator=(const HashStream& other) = delete;
+
+  tls::ostream& stream() { return _stream; }
+  bytes digest();
+
+  // Write the digest to a buffer of the hash size, then start over, so that
+  // one stream can hash many inputs
+  void digest_into(uint8_t* out);
+
+private:
+  hpke::Digest::Context _ctx;
+  tls::ostream _stream;
+
+  void write(const uint8_t* data, size_t size) override;
+};
+
+extern const std::array<CipherSuite::ID, 6> all_supported_suites;
 
 bool
 constant_time_eq(const bytes& lhs, const bytes& rhs);
 
+// A parsed form of a serialized key, created on first use and then shared by
+// all copies of the key.  Access is thread-safe.
+//
+// The parsed key remembers the suite and data it was parsed from, and is only
+// used for that same suite and data, so a key whose data is changed is parsed
+// again.  A private key's data is not copied; the parsed key remembers a
+// SHA-256 fingerprint of it instead, which is compared in constant time.
+template<typename T, bool Secret = false>
+class ParsedKey
+{
+public:
+  ParsedKey() = default;
+
+  ParsedKey(const ParsedKey& other)
+    : _entry(std::atomic_load(&other._entry))
+  {}
+
+  ParsedKey& operator=(const ParsedKey& other)
+  {
+    if (&other != this) {
+      std::atomic_store(&_entry, std::atomic_load(&other._entry));
+    }
+    return *this;
+  }
+
+  template<typename Parse>
+  std::shared_ptr<const T> get(CipherSuite suite,
+                               const bytes& data,
+                               const Parse& parse) const
+  {
+    auto entry = std::atomic_load(&_entry);
+    if (!entry || !entry->matches(suite, data)) {
+      entry = std::make_shared<const Entry>(suite, data, parse());
+      std::atomic_store(&_entry, entry);
+    }
+
+    return std::shared_ptr<const T>(entry, entry->key.get());
+  }
+
+  void set(CipherSuite suite, const bytes& data, std::unique_ptr<T> key) const
+  {
+    auto entry = std::make_shared<const Entry>(suite, data, std::move(key));
+    std::atomic_store(&_entry, entry);
+  }
+
+private:
+  struct Entry
+  {
+    CipherSuite::ID suite;
+    bytes data; // The fingerprint, for a private key
+    std::unique_ptr<const T> key;
+
+    Entry(CipherSuite suite_in, const bytes& data_in, std::unique_ptr<T> key_in)
+      : suite(suite_in.id)
+      , data(fingerprint(data_in))
+      , key(std::move(key_in))
+    {}
+
+    bool matches(CipherSuite other_suite, const bytes& other_data) const
+    {
+      if (other_suite.id != suite) {
+        return false;
+      }
+
+      if constexpr (Secret) {
+        return constant_time_eq(fingerprint(other_data), data);
+      } else {
+        return other_data == data;
+      }
+    }
+
+    static bytes fingerprint(const bytes& data)
+    {
+      if constexpr (Secret) {
+        return hpke::Digest::get<hpke::Digest::ID::SHA256>().hash(data);
+      } else {
+        return data;
+      }
+    }
+  };
+
+  mutable std::shared_ptr<const Entry> _entry;
+};
+
+// Utilities
+using hpke::random_bytes;
+
 // HPKE Keys
 struct HPKECiphertext
 {
@@ -74,12 +251,20 @@ struct HPKEPublicKey
 {
   bytes data;
 
+  HPKEPublicKey() = default;
+  explicit HPKEPublicKey(bytes data_in);
+
   HPKECiphertext encrypt(CipherSuite suite,
                          const bytes& aad,
                          const bytes& pt) const;
 
   TLS_SERIALIZABLE(data)
   TLS_TRAITS(tls::vector<2>)
+
+private:
+  ParsedKey<hpke::KEM::PublicKey> _parsed;
+
+  friend struct HPKEPrivateKey;
 };
 
 struct HPKEPrivateKey
@@ -101,6 +286,8 @@ struct HPKEPrivateKey
   TLS_TRAITS(tls::vector<2>, tls::pass)
 
 private:
+  ParsedKey<hpke::KEM::PrivateKey, true> _parsed;
+
   HPKEPrivateKey(bytes priv_data, bytes pub_data);
 };
 
@@ -109,12 +296,20 @@ struct SignaturePublicKey
 {
   bytes data;
 
+  SignaturePublicKey() = default;
+  explicit SignaturePublicKey(bytes data_in);
+
   bool verify(const CipherSuite& suite,
               const bytes& message,
               const bytes& signature) const;
 
   TLS_SERIALIZABLE(data)
   TLS_TRAITS(tls::vector<2>)
+
+private:
+  ParsedKey<hpke::Signature::PublicKey> _parsed;
+
+  friend struct SignaturePrivateKey;
 };
 
 struct SignaturePrivateKey
@@ -132,6 +327,8 @@ struct SignaturePrivateKey
   TLS_TRAITS(tls::vector<2>, tls::pass)
 
 private:
+  ParsedKey<hpke::Signature::PrivateKey, true> _parsed;
+
   SignaturePrivateKey(bytes priv_data, bytes pub_data);
 };
 
@@ -12,15 +12,15 @@ struct HashRatchet;
 
 struct KeyAndNonce
 {
-  bytes key;
-  bytes nonce;
+  secret_bytes key;
+  secret_bytes nonce;
 };
 
 struct HashRatchet
 {
   CipherSuite suite;
   NodeIndex node;
-  bytes next_secret;
+  secret_bytes next_secret;
   uint32_t next_generation;
   std::map<uint32_t, KeyAndNonce> cache;
 
@@ -70,25 +70,48 @@ private:
   HashRatchet& chain(LeafIndex sender);
 };
 
+// An AEAD context for a key that protects many messages, so that the key
+// setup is done once rather than per message.  The context is created on
+// first use, and created again if it is asked for with a different key.
+// Copies do not share it, since a context may not be used from two threads
+// at once.
+class KeyedAEAD
+{
+public:
+  KeyedAEAD() = default;
+  KeyedAEAD(const KeyedAEAD& /* other */) {}
+  KeyedAEAD(KeyedAEAD&& other) = default;
+  KeyedAEAD& operator=(const KeyedAEAD& other);
+  KeyedAEAD& operator=(KeyedAEAD&& other) = default;
+
+  hpke::AEAD::KeyedContext& get(CipherSuite suite, const secret_bytes& key);
+
+private:
+  CipherSuite::ID _suite_id = CipherSuite::ID::unknown;
+  secret_bytes _key;
+  std::unique_ptr<hpke::AEAD::KeyedContext> _ctx;
+};
+
 struct KeyScheduleEpoch;
 
 struct KeyScheduleEpoch
 {
   CipherSuite suite;
-  bytes epoch_secret;
+  secret_bytes epoch_secret;
 
-  bytes sender_data_secret;
-  bytes sender_data_key;
+  secret_bytes sender_data_secret;
+  secret_bytes sender_data_key;
+  KeyedAEAD sender_data_aead;
 
-  bytes handshake_secret;
+  secret_bytes handshake_secret;
   GroupKeySource handshake_keys;
 
-  bytes application_secret;
+  secret_bytes application_secret;
   GroupKeySource application_keys;
 
-  bytes exporter_secret;
-  bytes confirmation_key;
-  bytes init_secret;
+  secret_bytes exporter_secret;
+  secret_bytes confirmation_key;
+  secret_bytes init_secret;
 
   KeyScheduleEpoch() = default;
 
@@ -102,6 +125,13 @@ struct KeyScheduleEpoch
   KeyScheduleEpoch next(LeafCount size,
                         const bytes& update_secret,
                         const bytes& context) const;
+
+  bytes seal_sender_data(const bytes& nonce,
+                         const bytes& aad,
+                         const bytes& pt);
+  std::optional<bytes> open_sender_data(const bytes& nonce,
+                                        const bytes& aad,
+                                        const bytes& ct);
 };
 
 bool
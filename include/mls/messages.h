@@ -121,7 +121,9 @@ struct Welcome
   bytes encrypted_group_info;
 
   Welcome();
-  Welcome(CipherSuite suite, bytes epoch_secret, const GroupInfo& group_info);
+  Welcome(CipherSuite suite,
+          const secret_bytes& epoch_secret,
+          const GroupInfo& group_info);
 
   void encrypt(const KeyPackage& kp, const std::optional<bytes>& path_secret);
   std::optional<int> find(const KeyPackage& kp) const;
@@ -131,9 +133,9 @@ struct Welcome
   TLS_TRAITS(tls::pass, tls::pass, tls::vector<4>, tls::vector<4>)
 
 private:
-  bytes _epoch_secret;
+  secret_bytes _epoch_secret;
   std::tuple<bytes, bytes> group_info_key_nonce(
-    const bytes& epoch_secret) const;
+    const CipherSuite::Expander& epoch) const;
 };
 
 ///
@@ -316,6 +318,8 @@ struct MLSPlaintext
 
   bytes commit_content() const;
   bytes commit_auth_data() const;
+  void write_commit_content(tls::ostream& w) const;
+  void write_commit_auth_data(tls::ostream& w) const;
 
   TLS_SERIALIZABLE(group_id,
                    epoch,
@@ -365,4 +369,21 @@ struct MLSCiphertext
              tls::vector<4>)
 };
 
+// The leading fields of an encoded MLSCiphertext, read without decoding the
+// rest of the message and without allocating, so that a message can be routed
+// to its group, or rejected, before any further work is done on it.  The group
+// ID points into the buffer that was parsed.
+struct MLSCiphertextHeader
+{
+  const uint8_t* group_id_data;
+  size_t group_id_size;
+  epoch_t epoch;
+  ContentType content_type;
+
+  static MLSCiphertextHeader peek(const uint8_t* data, size_t size);
+  static MLSCiphertextHeader peek(const bytes& data);
+
+  bool has_group_id(const bytes& group_id) const;
+};
+
 } // namespace mls
@@ -3,10 +3,12 @@
 #include <mls/common.h>
 #include <mls/credential.h>
 #include <mls/crypto.h>
+#include <tls/framing.h>
 
 namespace mls {
 
 class PendingJoin;
+class ProtectedMessage;
 class Session;
 
 class Client
@@ -41,6 +43,27 @@ private:
   friend class Client;
 };
 
+// An encoded application message whose ciphertext is referenced rather than
+// copied into the encoding.  The segments remain valid for the lifetime of
+// this object, e.g., to be written to a socket with writev().
+class ProtectedMessage
+{
+public:
+  ProtectedMessage(ProtectedMessage&& other) noexcept;
+  ProtectedMessage& operator=(ProtectedMessage&& other) noexcept;
+  ~ProtectedMessage();
+
+  size_t size() const;
+  std::vector<tls::ostream::segment> segments() const;
+
+private:
+  struct Inner;
+  std::unique_ptr<Inner> inner;
+
+  ProtectedMessage(Inner* inner);
+  friend class Session;
+};
+
 class Session
 {
 public:
@@ -51,6 +74,12 @@ public:
   // Settings
   void encrypt_handshake(bool enabled);
 
+  // The number of epochs, including the current one, for which state is kept
+  // in order to decrypt late messages.  Older epochs are discarded, and their
+  // secrets zeroized, as new ones are added.  By default, no epochs are
+  // discarded.
+  void history_limit(size_t epochs);
+
   // Message producers
   bytes add(const bytes& key_package_data);
   bytes update();
@@ -63,6 +92,7 @@ public:
   bool handle(const bytes& handshake_data);
 
   // Information about the current state
+  const bytes& group_id() const;
   epoch_t current_epoch() const;
   uint32_t index() const;
   bytes do_export(const std::string& label,
@@ -72,7 +102,9 @@ public:
 
   // Application message protection
   bytes protect(const bytes& plaintext);
+  ProtectedMessage protect_segments(const bytes& plaintext);
   bytes unprotect(const bytes& ciphertext);
+  bytes unprotect(const tls::frame& ciphertext);
 
 protected:
   struct Inner;
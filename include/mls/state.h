@@ -84,6 +84,7 @@ public:
   ///
   /// Accessors
   ///
+  const bytes& group_id() const { return _group_id; }
   epoch_t epoch() const { return _epoch; }
   LeafIndex index() const { return _index; }
   CipherSuite cipher_suite() const { return _suite; }
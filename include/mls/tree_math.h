@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <tls/tls_syntax.h>
 #include <vector>
 
@@ -36,11 +38,11 @@ struct UInt32
 {
   uint32_t val;
 
-  UInt32()
+  constexpr UInt32()
     : val(0)
   {}
 
-  explicit UInt32(uint32_t val_in)
+  constexpr explicit UInt32(uint32_t val_in)
     : val(val_in)
   {}
 
@@ -71,7 +73,7 @@ struct LeafIndex : public UInt32
 struct NodeIndex : public UInt32
 {
   using UInt32::UInt32;
-  explicit NodeIndex(const LeafIndex x)
+  constexpr explicit NodeIndex(const LeafIndex x)
     : UInt32(2 * x.val)
   {}
 
@@ -81,36 +83,254 @@ struct NodeIndex : public UInt32
 // Internal namespace to keep these generic names clean
 namespace tree_math {
 
-uint32_t
-level(NodeIndex x);
+// Bit-counting primitives, which compile to single instructions where the
+// compiler provides them.  The argument must be nonzero.
+constexpr uint32_t
+clz(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<uint32_t>(__builtin_clz(x));
+#else
+  uint32_t n = 0;
+  for (uint32_t bit = 0x80000000; (x & bit) == 0; bit >>= 1U) {
+    n += 1;
+  }
+  return n;
+#endif
+}
+
+constexpr uint32_t
+ctz(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<uint32_t>(__builtin_ctz(x));
+#else
+  uint32_t n = 0;
+  for (uint32_t bit = 0x01; (x & bit) == 0; bit <<= 1U) {
+    n += 1;
+  }
+  return n;
+#endif
+}
+
+constexpr uint32_t
+log2(uint32_t x)
+{
+  return (x == 0) ? 0 : 31 - clz(x);
+}
+
+// The level of a node is the number of trailing one bits in its index
+constexpr uint32_t
+level(NodeIndex x)
+{
+  return (~x.val == 0) ? 32 : ctz(~x.val);
+}
 
 // Node relationships
-NodeIndex
-root(NodeCount w);
+constexpr NodeIndex
+root(NodeCount w)
+{
+  return NodeIndex{ (uint32_t(1) << log2(w.val)) - 1 };
+}
+
+constexpr NodeIndex
+left(NodeIndex x)
+{
+  // For a leaf, the mask is zero and the node is its own left child
+  return NodeIndex{ x.val ^ ((uint32_t(1) << level(x)) >> 1U) };
+}
+
+constexpr NodeIndex
+right(NodeIndex x, NodeCount w)
+{
+  auto k = level(x);
+  if (k == 0) {
+    return x;
+  }
 
-NodeIndex
-left(NodeIndex x);
+  // Only on the right edge of a tree that is not full does the right child
+  // fall outside the tree, in which case we descend to its left
+  auto r = NodeIndex{ x.val ^ (uint32_t(0x03) << (k - 1)) };
+  while (r.val >= w.val) {
+    r = left(r);
+  }
+  return r;
+}
 
-NodeIndex
-right(NodeIndex x, NodeCount w);
+// The parent of a node in an infinite tree
+constexpr NodeIndex
+parent_step(NodeIndex x)
+{
+  auto k = level(x);
+  auto one = uint32_t(1);
+  return NodeIndex{ (x.val | (one << k)) & ~(one << (k + 1)) };
+}
+
+constexpr NodeIndex
+parent(NodeIndex x, NodeCount w)
+{
+  if (x.val == root(w).val) {
+    return x;
+  }
+
+  // As with right(), this only repeats on the right edge of the tree
+  auto p = parent_step(x);
+  while (p.val >= w.val) {
+    p = parent_step(p);
+  }
+  return p;
+}
+
+constexpr NodeIndex
+sibling(NodeIndex x, NodeCount w)
+{
+  auto p = parent(x, w);
+  if (x.val < p.val) {
+    return right(p, w);
+  }
 
-NodeIndex
-parent(NodeIndex x, NodeCount w);
+  if (x.val > p.val) {
+    return left(p);
+  }
 
-NodeIndex
-sibling(NodeIndex x, NodeCount w);
+  // root's sibling is itself
+  return p;
+}
 
+// Whether x is in the subtree rooted at y
+constexpr bool
+in_path(NodeIndex x, NodeIndex y)
+{
+  auto lx = level(x);
+  auto ly = level(y);
+  return lx <= ly && (x.val >> (ly + 1) == y.val >> (ly + 1));
+}
+
+// Common ancestor of two leaves: the leaves' indices agree above the highest
+// bit in which they differ, and the ancestor is at that bit's level
+constexpr NodeIndex
+ancestor(LeafIndex l, LeafIndex r)
+{
+  auto ln = NodeIndex(l);
+  auto rn = NodeIndex(r);
+  if (ln.val == rn.val) {
+    return ln;
+  }
+
+  auto k = 32 - clz(ln.val ^ rn.val);
+  auto prefix = (ln.val >> k) << k;
+  return NodeIndex{ prefix + (uint32_t(1) << (k - 1)) - 1 };
+}
+
+// An allocation-free view of the path from a node up to the root.  Each step
+// of the walk yields a function of the node it is at, so that the same walk
+// produces the direct path (the parent of each node) and the copath (the
+// sibling of each node).  The root itself is never the node a step is at, so
+// the view is empty for the root.
+template<NodeIndex (*Yield)(NodeIndex, NodeCount)>
+class PathRange
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeIndex;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const NodeIndex*;
+    using reference = NodeIndex;
+
+    constexpr iterator() = default;
+    constexpr iterator(NodeIndex node, NodeCount width)
+      : _node(node)
+      , _width(width)
+    {}
+
+    constexpr NodeIndex operator*() const { return Yield(_node, _width); }
+
+    constexpr iterator& operator++()
+    {
+      _node = parent(_node, _width);
+      return *this;
+    }
+
+    constexpr iterator operator++(int)
+    {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    constexpr bool operator==(const iterator& other) const
+    {
+      return _node.val == other._node.val;
+    }
+
+    constexpr bool operator!=(const iterator& other) const
+    {
+      return !(*this == other);
+    }
+
+  private:
+    NodeIndex _node;
+    NodeCount _width;
+  };
+
+  constexpr PathRange(NodeIndex x, NodeCount w)
+    : _begin(x, w)
+    , _end(root(w), w)
+  {}
+
+  constexpr iterator begin() const { return _begin; }
+  constexpr iterator end() const { return _end; }
+
+  constexpr bool empty() const { return _begin == _end; }
+
+  constexpr size_t size() const
+  {
+    size_t n = 0;
+    for (auto it = _begin; it != _end; ++it) {
+      n += 1;
+    }
+    return n;
+  }
+
+private:
+  iterator _begin;
+  iterator _end;
+};
+
+using DirpathRange = PathRange<parent>;
+using CopathRange = PathRange<sibling>;
+
+// The same paths, as vectors
 std::vector<NodeIndex>
 dirpath(NodeIndex x, NodeCount w);
 
 std::vector<NodeIndex>
 copath(NodeIndex x, NodeCount w);
 
-bool
-in_path(NodeIndex x, NodeIndex y);
+} // namespace tree_math
 
-NodeIndex
-ancestor(LeafIndex l, LeafIndex r);
+// A view of a run of consecutive node indices in an array owned by someone
+// else, valid only as long as the array is not modified
+class NodeSpan
+{
+public:
+  NodeSpan(const NodeIndex* begin, const NodeIndex* end)
+    : _begin(begin)
+    , _end(end)
+  {}
+
+  const NodeIndex* begin() const { return _begin; }
+  const NodeIndex* end() const { return _end; }
+  size_t size() const { return static_cast<size_t>(_end - _begin); }
+  bool empty() const { return _begin == _end; }
+  const NodeIndex& operator[](size_t i) const { return _begin[i]; }
+
+private:
+  const NodeIndex* _begin;
+  const NodeIndex* _end;
+};
 
-} // namespace tree_math
 } // namespace mls
@@ -5,6 +5,7 @@
 #include "mls/crypto.h"
 #include "mls/tree_math.h"
 #include <tls/tls_syntax.h>
+#include <unordered_map>
 
 namespace mls {
 
@@ -21,7 +22,6 @@ struct Node
 struct OptionalNode
 {
   std::optional<Node> node;
-  bytes hash;
 
   KeyPackage& key_package() { return std::get<KeyPackage>(node.value().node); }
   const KeyPackage& key_package() const
@@ -35,23 +35,50 @@ struct OptionalNode
     return std::get<ParentNode>(node.value().node);
   }
 
-  void set_leaf_hash(CipherSuite suite, NodeIndex index);
-  void set_parent_hash(CipherSuite suite,
-                       NodeIndex index,
-                       const bytes& left,
-                       const bytes& right);
+  // The hashes of the children are given as pointers to hash_size bytes, so
+  // that they can be read in place from wherever they are stored
+  void write_leaf_hash_input(tls::ostream& w, NodeIndex index) const;
+  void write_parent_hash_input(tls::ostream& w,
+                               NodeIndex index,
+                               const uint8_t* left,
+                               const uint8_t* right,
+                               size_t hash_size) const;
+
+  bytes hash_leaf(CipherSuite suite, NodeIndex index) const;
+  bytes hash_parent(CipherSuite suite,
+                    NodeIndex index,
+                    const bytes& left,
+                    const bytes& right) const;
 
   TLS_SERIALIZABLE(node)
 };
 
 struct TreeKEMPublicKey;
 
+// How the hashes of a whole tree are computed when none of them are known,
+// e.g., when joining a group.  Subtrees are hashed in parallel, on the calling
+// thread and (threads - 1) others, and the levels above them are then hashed
+// on the calling thread.  Trees with fewer leaves than the threshold are
+// hashed sequentially.  The result is the same either way.  These options
+// apply to the whole process, and by default hashing is sequential.
+struct TreeHashOptions
+{
+  size_t threads = 1;
+  uint32_t parallel_threshold = 4096;
+};
+
+void
+set_tree_hash_options(const TreeHashOptions& options);
+
+TreeHashOptions
+tree_hash_options();
+
 struct TreeKEMPrivateKey
 {
   CipherSuite suite;
   LeafIndex index;
   bytes update_secret;
-  std::map<NodeIndex, bytes> path_secrets;
+  std::map<NodeIndex, secret_bytes> path_secrets;
   std::map<NodeIndex, HPKEPrivateKey> private_key_cache;
 
   static TreeKEMPrivateKey solo(CipherSuite suite,
@@ -112,10 +139,24 @@ struct TreeKEMPublicKey
   bytes root_hash() const;
   LeafCount size() const;
 
+  // Find the leftmost leaf holding a KeyPackage, or a credential with a given
+  // identity, as returned by Credential::identity().  The non-const versions
+  // index the leaves if they are not indexed already; the const versions scan
+  // them in that case.
+  std::optional<LeafIndex> find(const KeyPackage& kp);
   std::optional<LeafIndex> find(const KeyPackage& kp) const;
+  std::optional<LeafIndex> find_by_identity(const bytes& identity);
+  std::optional<LeafIndex> find_by_identity(const bytes& identity) const;
   std::optional<KeyPackage> key_package(LeafIndex index) const;
   std::vector<NodeIndex> resolve(NodeIndex index) const;
 
+  // The resolution of a node, as a view into the resolution index.  The index
+  // is built by set_hash_all() if the tree does not have one, so this throws
+  // for a tree that has not been hashed since it was deserialized; check
+  // resolutions_valid() first, and fall back to resolve() if it is false.
+  bool resolutions_valid() const;
+  NodeSpan resolution(NodeIndex index) const;
+
   std::tuple<TreeKEMPrivateKey, DirectPath> encap(
     LeafIndex from,
     const bytes& context,
@@ -137,9 +178,69 @@ struct TreeKEMPublicKey
   TLS_TRAITS(tls::vector<4>)
 
 private:
+  // The tree hashes of all the nodes, stored back to back, and the nodes
+  // whose hashes are out of date.  If the hashes do not cover every node,
+  // e.g., because the nodes were deserialized, they are all out of date.
+  std::vector<uint8_t> _hashes;
+  std::vector<NodeIndex> _dirty;
+  std::vector<bool> _is_dirty;
+
+  bool hashes_valid() const;
+  void mark_dirty(NodeIndex index);
+  void hash_node(HashStream& w,
+                 NodeIndex index,
+                 NodeCount width,
+                 size_t hash_size);
+  void hash_subtree(HashStream& w,
+                    uint32_t block,
+                    uint32_t split_level,
+                    NodeCount width,
+                    size_t hash_size);
+  void hash_all(NodeCount width, size_t hash_size);
+
+  // The resolution of every node, updated along with the nodes.  Each node's
+  // resolution is a range in a shared pool.  A changed resolution is appended
+  // to the pool, leaving the old one behind until the pool is compacted.  If
+  // the ranges do not cover every node, e.g., because the nodes were
+  // deserialized, the index is rebuilt when the tree is next hashed.
+  struct ResolutionRange
+  {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  std::vector<ResolutionRange> _res_ranges;
+  std::vector<NodeIndex> _res_pool;
+  size_t _res_live = 0;
+
+  void set_resolution(NodeIndex index, NodeCount width);
+  void update_resolutions(LeafIndex index);
+  void rebuild_resolutions();
+  void compact_resolutions();
+
+  // The leaves, by the hash of their KeyPackage and by the identity in their
+  // credential.  As with the resolutions, the index is out of date unless it
+  // was kept up to date at the current width.  The maps are copied along with
+  // the tree, so copying an indexed tree (and so a State) costs two hash table
+  // entries per leaf on top of the nodes themselves.
+  struct BytesHash
+  {
+    size_t operator()(const bytes& data) const;
+  };
+
+  using LeafMap = std::unordered_multimap<bytes, LeafIndex, BytesHash>;
+
+  LeafMap _kp_index;
+  LeafMap _identity_index;
+  size_t _leaf_index_width = 0;
+
+  bool leaf_index_valid() const;
+  void index_leaf(LeafIndex index);
+  void unindex_leaf(LeafIndex index);
+  void rebuild_leaf_index();
+
   void clear_hash_all();
   void clear_hash_path(LeafIndex index);
-  bytes get_hash(NodeIndex index);
 
   friend struct TreeKEMPrivateKey;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -29,4 +31,54 @@ operator^(const bytes& lhs, const bytes& rhs);
 std::ostream&
 operator<<(std::ostream& out, const bytes& data);
 
+// A short byte string for secret values, such as keys, nonces, and the
+// secrets they are derived from.  The data is stored inline instead of on the
+// heap, so secrets can be stored and copied without allocating, and it is
+// zeroized when the string is cleared, overwritten, or destroyed.
+class secret_bytes
+{
+public:
+  static const size_t max_size = 64;
+
+  secret_bytes() = default;
+  secret_bytes(const uint8_t* data, size_t size);
+  secret_bytes(const bytes& data); // NOLINT(google-explicit-constructor)
+  secret_bytes(const secret_bytes& other);
+  secret_bytes(secret_bytes&& other) noexcept;
+  secret_bytes& operator=(const secret_bytes& other);
+  secret_bytes& operator=(secret_bytes&& other) noexcept;
+  ~secret_bytes();
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const uint8_t* data() const { return _data.data(); }
+  uint8_t* data() { return _data.data(); }
+  const uint8_t* begin() const { return _data.data(); }
+  const uint8_t* end() const { return _data.data() + _size; }
+
+  void clear();
+
+  // Values written through data() after resizing stay inline, so crypto code
+  // can produce a secret in place.  Shrinking zeroizes the bytes dropped.
+  void resize(size_t size);
+
+  // Crypto APIs take secrets as bytes, so this makes a heap copy that is not
+  // zeroized when it is freed.  It is explicit so that every such copy is
+  // visible at the call site.
+  explicit operator bytes() const;
+
+private:
+  std::array<uint8_t, max_size> _data{};
+  size_t _size = 0;
+};
+
+bool
+operator==(const secret_bytes& lhs, const secret_bytes& rhs);
+
+bool
+operator!=(const secret_bytes& lhs, const secret_bytes& rhs);
+
+std::ostream&
+operator<<(std::ostream& out, const secret_bytes& data);
+
 } // namespace bytes_ns
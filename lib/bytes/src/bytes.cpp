@@ -1,5 +1,6 @@
 #include "bytes/bytes.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -85,4 +86,118 @@ operator<<(std::ostream& out, const bytes& data)
   return out << to_hex(abbrev) << "...";
 }
 
+///
+/// secret_bytes
+///
+
+// Writes through a volatile pointer are not optimized away, even when the
+// memory is about to be freed
+static void
+zeroize(uint8_t* data, size_t size)
+{
+  volatile auto* ptr = data;
+  for (size_t i = 0; i < size; i += 1) {
+    ptr[i] = 0;
+  }
+}
+
+secret_bytes::secret_bytes(const uint8_t* data, size_t size)
+{
+  if (size > max_size) {
+    throw std::invalid_argument("Secret too large");
+  }
+
+  std::copy(data, data + size, _data.begin());
+  _size = size;
+}
+
+secret_bytes::secret_bytes(const bytes& data)
+  : secret_bytes(data.data(), data.size())
+{}
+
+secret_bytes::secret_bytes(const secret_bytes& other)
+  : secret_bytes(other.data(), other.size())
+{}
+
+// The value lives inline, so a move is a copy that zeroizes the source
+secret_bytes::secret_bytes(secret_bytes&& other) noexcept
+  : _size(other._size)
+{
+  std::copy(other.begin(), other.end(), _data.begin());
+  other.clear();
+}
+
+secret_bytes&
+secret_bytes::operator=(const secret_bytes& other)
+{
+  if (&other != this) {
+    clear();
+    std::copy(other.begin(), other.end(), _data.begin());
+    _size = other._size;
+  }
+  return *this;
+}
+
+secret_bytes&
+secret_bytes::operator=(secret_bytes&& other) noexcept
+{
+  if (&other != this) {
+    clear();
+    std::copy(other.begin(), other.end(), _data.begin());
+    _size = other._size;
+    other.clear();
+  }
+  return *this;
+}
+
+secret_bytes::~secret_bytes()
+{
+  clear();
+}
+
+void
+secret_bytes::clear()
+{
+  zeroize(_data.data(), _size);
+  _size = 0;
+}
+
+void
+secret_bytes::resize(size_t size)
+{
+  if (size > max_size) {
+    throw std::invalid_argument("Secret too large");
+  }
+
+  if (size < _size) {
+    zeroize(_data.data() + size, _size - size);
+  }
+
+  _size = size;
+}
+
+secret_bytes::operator bytes() const
+{
+  return bytes(begin(), end());
+}
+
+bool
+operator==(const secret_bytes& lhs, const secret_bytes& rhs)
+{
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+bool
+operator!=(const secret_bytes& lhs, const secret_bytes& rhs)
+{
+  return !(lhs == rhs);
+}
+
+std::ostream&
+operator<<(std::ostream& out, const secret_bytes& data)
+{
+  // Secret values are not written out, e.g., to logs
+  return out << "secret_bytes(" << data.size() << ")";
+}
+
 } // namespace bytes_ns
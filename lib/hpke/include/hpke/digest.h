@@ -23,12 +23,68 @@ struct Digest
 
   bytes hash(const bytes& data) const;
   bytes hmac(const bytes& key, const bytes& data) const;
+  bytes hmac(const secret_bytes& key, const bytes& data) const;
+
+  // An incremental hash or HMAC computation, for input that is produced in
+  // pieces.  Copying a context copies its state, so two computations that
+  // share a prefix only process the prefix once.  A context cannot be updated
+  // after it is finished, until it is reset to start a new computation with
+  // the same hash function and key.
+  class Context
+  {
+  public:
+    Context(const Context& other);
+    Context(Context&& other) noexcept;
+    Context& operator=(const Context& other);
+    Context& operator=(Context&& other) noexcept;
+    ~Context();
+
+    void update(const uint8_t* data, size_t size);
+    void update(const bytes& data);
+    bytes finish();
+    void finish(uint8_t* out); // Writes the output, of hash_size() bytes
+    void reset();
+
+  private:
+    struct Inner;
+    std::unique_ptr<Inner> _inner;
+
+    Context(std::unique_ptr<Inner> inner);
+    friend struct Digest;
+  };
+
+  Context hash_context() const;
+  Context hmac_context(const bytes& key) const;
+
+  // An HMAC key with the hash states after the inner and outer key blocks
+  // computed once, so that each MAC under the key only hashes the data.
+  // Copies share the precomputed states, which are never modified, so a
+  // keyed HMAC may be used from several threads at once.
+  class KeyedHMAC
+  {
+  public:
+    bytes mac(const bytes& data) const;
+    Context context() const;
+
+  private:
+    struct Inner;
+    std::shared_ptr<const Inner> _inner;
+
+    KeyedHMAC(std::shared_ptr<const Inner> inner);
+    friend struct Digest;
+  };
+
+  KeyedHMAC keyed_hmac(const bytes& key) const;
+  KeyedHMAC keyed_hmac(const secret_bytes& key) const;
 
   size_t hash_size() const;
 
 private:
   const size_t output_size;
 
+  bytes hmac(const uint8_t* key, size_t key_size, const bytes& data) const;
+  KeyedHMAC keyed_hmac(const uint8_t* key, size_t key_size) const;
+
   explicit Digest(ID id);
   friend Digest make_digest(ID id);
 
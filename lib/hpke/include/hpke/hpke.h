@@ -85,10 +85,27 @@ struct KDF
   const ID id;
 
   virtual bytes extract(const bytes& salt, const bytes& ikm) const = 0;
+  virtual bytes extract(const secret_bytes& salt, const bytes& ikm) const = 0;
   virtual bytes expand(const bytes& prk,
                        const bytes& info,
                        size_t size) const = 0;
 
+  // Expansions from a single PRK, with the setup that depends only on the PRK
+  // done once for all of them.  An output that is itself a secret can be
+  // written into a secret_bytes, so that it never reaches the heap.
+  struct Expander
+  {
+    virtual ~Expander() = default;
+    virtual bytes expand(const bytes& info, size_t size) const = 0;
+    virtual void expand(const bytes& info,
+                        size_t size,
+                        secret_bytes& out) const = 0;
+  };
+
+  virtual std::unique_ptr<Expander> expander(const bytes& prk) const = 0;
+  virtual std::unique_ptr<Expander> expander(
+    const secret_bytes& prk) const = 0;
+
   virtual size_t hash_size() const = 0;
 
   bytes labeled_extract(const bytes& suite_id,
@@ -130,6 +147,34 @@ struct AEAD
                                     const bytes& aad,
                                     const bytes& ct) const = 0;
 
+  // Keys and nonces held as secret_bytes are used in place, without a copy
+  virtual bytes seal(const secret_bytes& key,
+                     const secret_bytes& nonce,
+                     const bytes& aad,
+                     const bytes& pt) const = 0;
+  virtual std::optional<bytes> open(const secret_bytes& key,
+                                    const secret_bytes& nonce,
+                                    const bytes& aad,
+                                    const bytes& ct) const = 0;
+
+  // An AEAD bound to a single key, so that the key setup is done once and
+  // reused for every message sealed or opened with that key.  A keyed context
+  // is not safe for concurrent use.
+  struct KeyedContext
+  {
+    virtual ~KeyedContext() = default;
+    virtual bytes seal(const bytes& nonce,
+                       const bytes& aad,
+                       const bytes& pt) = 0;
+    virtual std::optional<bytes> open(const bytes& nonce,
+                                      const bytes& aad,
+                                      const bytes& ct) = 0;
+  };
+
+  virtual std::unique_ptr<KeyedContext> keyed(const bytes& key) const = 0;
+  virtual std::unique_ptr<KeyedContext> keyed(
+    const secret_bytes& key) const = 0;
+
   virtual size_t key_size() const = 0;
   virtual size_t nonce_size() const = 0;
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+
 #include <bytes/bytes.h>
 using namespace bytes_ns;
 
@@ -8,4 +10,37 @@ namespace hpke {
 bytes
 random_bytes(size_t size);
 
+// By default, random bytes are drawn from OpenSSL's shared generator on every
+// call.  A per-thread generator can be enabled instead, which serves small
+// requests from a buffer of pre-generated output, so that they do not contend
+// on the shared generator.
+//
+// The per-thread generator is a ChaCha20 keystream, seeded from the shared
+// generator.  Each time the buffer is refilled, the key is replaced with fresh
+// output, and bytes are erased from the buffer as they are handed out, so
+// earlier output cannot be recovered from the generator's state.
+struct ThreadRandomOptions
+{
+  // Output generated per refill, and the largest request served from it.
+  // Larger requests go to the shared generator directly.
+  size_t buffer_size = 4096;
+  size_t max_request = 256;
+
+  // Reseed from the shared generator after this much output or this much
+  // time, whichever comes first.  The time is checked every 64 requests, so a
+  // thread that makes few requests may keep its key for somewhat longer.
+  size_t reseed_bytes = size_t(1) << 20;
+  std::chrono::seconds reseed_interval{ 300 };
+
+  // Reseed in a child process after fork(), so that parent and child do not
+  // share output.  This costs a getpid() call per request.
+  bool fork_safe = true;
+};
+
+void
+enable_thread_random(const ThreadRandomOptions& options);
+
+void
+disable_thread_random();
+
 } // namespace hpke
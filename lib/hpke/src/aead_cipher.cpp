@@ -113,102 +113,211 @@ AEADCipher::AEADCipher(AEAD::ID id_in)
   , tag_size(cipher_tag_size(id))
 {}
 
-bytes
-AEADCipher::seal(const bytes& key,
-                 const bytes& nonce,
-                 const bytes& aad,
-                 const bytes& pt) const
+// The cipher reads its key and nonce lengths from the secrets' inline storage,
+// so a secret shorter than that would be read past its end
+void
+AEADCipher::check_sizes(size_t key_size, size_t nonce_size) const
 {
-  auto ctx = make_typed_unique(EVP_CIPHER_CTX_new());
-  if (ctx == nullptr) {
-    throw openssl_error();
+  if (key_size != nk) {
+    throw std::runtime_error("Invalid AEAD key size");
   }
 
-  const auto* cipher = openssl_cipher(id);
-  if (1 != EVP_EncryptInit(ctx.get(), cipher, key.data(), nonce.data())) {
+  if (nonce_size < nn) {
+    throw std::runtime_error("Invalid AEAD nonce size");
+  }
+}
+
+// Seal and open with a cipher context that has already been initialized
+// with a cipher and key, so that only the nonce needs to be set
+static bytes
+seal_with(EVP_CIPHER_CTX* ctx,
+          size_t tag_size,
+          const uint8_t* nonce,
+          const bytes& aad,
+          const bytes& pt)
+{
+  if (1 != EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce)) {
     throw openssl_error();
   }
 
   int outlen = 0;
   if (!aad.empty()) {
-    if (1 != EVP_EncryptUpdate(
-               ctx.get(), nullptr, &outlen, aad.data(), aad.size())) {
+    if (1 != EVP_EncryptUpdate(ctx, nullptr, &outlen, aad.data(), aad.size())) {
       throw openssl_error();
     }
   }
 
-  bytes ct(pt.size());
-  if (1 !=
-      EVP_EncryptUpdate(ctx.get(), ct.data(), &outlen, pt.data(), pt.size())) {
+  bytes ct(pt.size() + tag_size);
+  if (1 != EVP_EncryptUpdate(ctx, ct.data(), &outlen, pt.data(), pt.size())) {
     throw openssl_error();
   }
 
   // Providing nullptr as an argument is safe here because this
   // function never writes with GCM; it only computes the tag
-  if (1 != EVP_EncryptFinal(ctx.get(), nullptr, &outlen)) {
+  if (1 != EVP_EncryptFinal_ex(ctx, nullptr, &outlen)) {
     throw openssl_error();
   }
 
-  bytes tag(tag_size);
-  if (1 != EVP_CIPHER_CTX_ctrl(
-             ctx.get(), EVP_CTRL_GCM_GET_TAG, tag_size, tag.data())) {
+  auto* tag = ct.data() + pt.size();
+  if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, tag_size, tag)) {
     throw openssl_error();
   }
 
-  ct.insert(ct.end(), tag.begin(), tag.end());
   return ct;
 }
 
-std::optional<bytes>
-AEADCipher::open(const bytes& key,
-                 const bytes& nonce,
-                 const bytes& aad,
-                 const bytes& ct) const
+static std::optional<bytes>
+open_with(EVP_CIPHER_CTX* ctx,
+          size_t tag_size,
+          const uint8_t* nonce,
+          const bytes& aad,
+          const bytes& ct)
 {
   if (ct.size() < tag_size) {
     throw std::runtime_error("AEAD ciphertext smaller than tag size");
   }
 
-  auto ctx = make_typed_unique(EVP_CIPHER_CTX_new());
-  if (ctx == nullptr) {
-    throw openssl_error();
-  }
-
-  const auto* cipher = openssl_cipher(id);
-  if (1 != EVP_DecryptInit(ctx.get(), cipher, key.data(), nonce.data())) {
+  if (1 != EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce)) {
     throw openssl_error();
   }
 
   auto inner_ct_size = ct.size() - tag_size;
   auto tag = bytes(ct.begin() + inner_ct_size, ct.end());
-  if (1 != EVP_CIPHER_CTX_ctrl(
-             ctx.get(), EVP_CTRL_GCM_SET_TAG, tag_size, tag.data())) {
+  if (1 !=
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tag_size, tag.data())) {
     throw openssl_error();
   }
 
   int out_size = 0;
   if (!aad.empty()) {
-    if (1 != EVP_DecryptUpdate(
-               ctx.get(), nullptr, &out_size, aad.data(), aad.size())) {
+    if (1 !=
+        EVP_DecryptUpdate(ctx, nullptr, &out_size, aad.data(), aad.size())) {
       throw openssl_error();
     }
   }
 
   bytes pt(inner_ct_size);
   if (1 != EVP_DecryptUpdate(
-             ctx.get(), pt.data(), &out_size, ct.data(), inner_ct_size)) {
+             ctx, pt.data(), &out_size, ct.data(), inner_ct_size)) {
     throw openssl_error();
   }
 
   // Providing nullptr as an argument is safe here because this
   // function never writes with GCM; it only verifies the tag
-  if (1 != EVP_DecryptFinal(ctx.get(), nullptr, &out_size)) {
+  if (1 != EVP_DecryptFinal_ex(ctx, nullptr, &out_size)) {
     throw std::runtime_error("AEAD authentication failure");
   }
 
   return pt;
 }
 
+static typed_unique_ptr<EVP_CIPHER_CTX>
+new_cipher_ctx(AEAD::ID id, const uint8_t* key, bool encrypt)
+{
+  auto ctx = make_typed_unique(EVP_CIPHER_CTX_new());
+  if (ctx == nullptr) {
+    throw openssl_error();
+  }
+
+  const auto* cipher = openssl_cipher(id);
+  auto* init = (encrypt) ? EVP_EncryptInit_ex : EVP_DecryptInit_ex;
+  if (1 != init(ctx.get(), cipher, nullptr, key, nullptr)) {
+    throw openssl_error();
+  }
+
+  return ctx;
+}
+
+bytes
+AEADCipher::seal(const bytes& key,
+                 const bytes& nonce,
+                 const bytes& aad,
+                 const bytes& pt) const
+{
+  auto ctx = new_cipher_ctx(id, key.data(), true);
+  return seal_with(ctx.get(), tag_size, nonce.data(), aad, pt);
+}
+
+std::optional<bytes>
+AEADCipher::open(const bytes& key,
+                 const bytes& nonce,
+                 const bytes& aad,
+                 const bytes& ct) const
+{
+  auto ctx = new_cipher_ctx(id, key.data(), false);
+  return open_with(ctx.get(), tag_size, nonce.data(), aad, ct);
+}
+
+bytes
+AEADCipher::seal(const secret_bytes& key,
+                 const secret_bytes& nonce,
+                 const bytes& aad,
+                 const bytes& pt) const
+{
+  check_sizes(key.size(), nonce.size());
+  auto ctx = new_cipher_ctx(id, key.data(), true);
+  return seal_with(ctx.get(), tag_size, nonce.data(), aad, pt);
+}
+
+std::optional<bytes>
+AEADCipher::open(const secret_bytes& key,
+                 const secret_bytes& nonce,
+                 const bytes& aad,
+                 const bytes& ct) const
+{
+  check_sizes(key.size(), nonce.size());
+  auto ctx = new_cipher_ctx(id, key.data(), false);
+  return open_with(ctx.get(), tag_size, nonce.data(), aad, ct);
+}
+
+// The key schedule for each direction is computed once, when the context is
+// created; each message then only resets the nonce
+struct AEADCipherContext : public AEAD::KeyedContext
+{
+  AEADCipherContext(AEAD::ID id, size_t tag_size_in, const uint8_t* key)
+    : tag_size(tag_size_in)
+    , seal_ctx(new_cipher_ctx(id, key, true))
+    , open_ctx(new_cipher_ctx(id, key, false))
+  {}
+
+  bytes seal(const bytes& nonce, const bytes& aad, const bytes& pt) override
+  {
+    return seal_with(seal_ctx.get(), tag_size, nonce.data(), aad, pt);
+  }
+
+  std::optional<bytes> open(const bytes& nonce,
+                            const bytes& aad,
+                            const bytes& ct) override
+  {
+    return open_with(open_ctx.get(), tag_size, nonce.data(), aad, ct);
+  }
+
+private:
+  size_t tag_size;
+  typed_unique_ptr<EVP_CIPHER_CTX> seal_ctx;
+  typed_unique_ptr<EVP_CIPHER_CTX> open_ctx;
+};
+
+std::unique_ptr<AEAD::KeyedContext>
+AEADCipher::keyed(const bytes& key) const
+{
+  if (key.size() != nk) {
+    throw std::runtime_error("Invalid AEAD key size");
+  }
+
+  return std::make_unique<AEADCipherContext>(id, tag_size, key.data());
+}
+
+std::unique_ptr<AEAD::KeyedContext>
+AEADCipher::keyed(const secret_bytes& key) const
+{
+  if (key.size() != nk) {
+    throw std::runtime_error("Invalid AEAD key size");
+  }
+
+  return std::make_unique<AEADCipherContext>(id, tag_size, key.data());
+}
+
 size_t
 AEADCipher::key_size() const
 {
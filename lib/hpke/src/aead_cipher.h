@@ -20,6 +20,18 @@ struct AEADCipher : public AEAD
                             const bytes& aad,
                             const bytes& ct) const override;
 
+  bytes seal(const secret_bytes& key,
+             const secret_bytes& nonce,
+             const bytes& aad,
+             const bytes& pt) const override;
+  std::optional<bytes> open(const secret_bytes& key,
+                            const secret_bytes& nonce,
+                            const bytes& aad,
+                            const bytes& ct) const override;
+
+  std::unique_ptr<KeyedContext> keyed(const bytes& key) const override;
+  std::unique_ptr<KeyedContext> keyed(const secret_bytes& key) const override;
+
   size_t key_size() const override;
   size_t nonce_size() const override;
 
@@ -29,6 +41,7 @@ private:
   const size_t tag_size;
 
   AEADCipher(AEAD::ID id_in);
+  void check_sizes(size_t key_size, size_t nonce_size) const;
   friend AEADCipher make_aead(AEAD::ID cipher_in);
 
   template<AEAD::ID id>
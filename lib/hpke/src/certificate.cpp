@@ -16,6 +16,13 @@ struct Certificate::ParsedCertificate
 
   static std::unique_ptr<ParsedCertificate> parse(const bytes& der)
   {
+#if defined(HPKE_INSECURE_SIMULATION)
+    // A certificate carries a real public key, which the simulated signature
+    // groups cannot use
+    throw std::runtime_error(
+      "X.509 certificates are not supported in an insecure simulation build");
+#endif
+
     const auto* buf = der.data();
     auto cert = make_typed_unique(d2i_X509(nullptr, &buf, der.size()));
     if (cert == nullptr) {
@@ -85,13 +85,25 @@ Digest::hash(const bytes& data) const
 
 bytes
 Digest::hmac(const bytes& key, const bytes& data) const
+{
+  return hmac(key.data(), key.size(), data);
+}
+
+bytes
+Digest::hmac(const secret_bytes& key, const bytes& data) const
+{
+  return hmac(key.data(), key.size(), data);
+}
+
+bytes
+Digest::hmac(const uint8_t* key, size_t key_size, const bytes& data) const
 {
   auto md = bytes(output_size);
   unsigned int size = 0;
   const auto* type = openssl_digest_type(id);
   if (nullptr == HMAC(type,
-                      key.data(),
-                      key.size(),
+                      key,
+                      key_size,
                       data.data(),
                       data.size(),
                       md.data(),
@@ -102,6 +114,212 @@ Digest::hmac(const bytes& key, const bytes& data) const
   return md;
 }
 
+///
+/// Incremental computation
+///
+
+// Exactly one of the two OpenSSL contexts is set, depending on whether this
+// is a hash or an HMAC
+struct Digest::Context::Inner
+{
+  size_t output_size;
+  typed_unique_ptr<EVP_MD_CTX> md;
+  typed_unique_ptr<HMAC_CTX> hmac;
+
+  Inner(size_t output_size_in)
+    : output_size(output_size_in)
+    , md(nullptr, typed_delete<EVP_MD_CTX>)
+    , hmac(nullptr, typed_delete<HMAC_CTX>)
+  {}
+
+  Inner(const Inner& other)
+    : Inner(other.output_size)
+  {
+    if (other.md) {
+      md = make_typed_unique(EVP_MD_CTX_new());
+      if (md == nullptr || 1 != EVP_MD_CTX_copy_ex(md.get(), other.md.get())) {
+        throw openssl_error();
+      }
+    }
+
+    if (other.hmac) {
+      hmac = make_typed_unique(HMAC_CTX_new());
+      if (hmac == nullptr ||
+          1 != HMAC_CTX_copy(hmac.get(), other.hmac.get())) {
+        throw openssl_error();
+      }
+    }
+  }
+
+  Inner& operator=(const Inner& other) = delete;
+};
+
+Digest::Context::Context(std::unique_ptr<Inner> inner)
+  : _inner(std::move(inner))
+{}
+
+Digest::Context::Context(const Context& other)
+  : _inner(std::make_unique<Inner>(*other._inner))
+{}
+
+Digest::Context::Context(Context&& other) noexcept = default;
+
+Digest::Context&
+Digest::Context::operator=(const Context& other)
+{
+  if (this != &other) {
+    _inner = std::make_unique<Inner>(*other._inner);
+  }
+  return *this;
+}
+
+Digest::Context&
+Digest::Context::operator=(Context&& other) noexcept = default;
+
+Digest::Context::~Context() = default;
+
+void
+Digest::Context::update(const uint8_t* data, size_t size)
+{
+  auto rv = (_inner->md) ? EVP_DigestUpdate(_inner->md.get(), data, size)
+                         : HMAC_Update(_inner->hmac.get(), data, size);
+  if (1 != rv) {
+    throw openssl_error();
+  }
+}
+
+void
+Digest::Context::update(const bytes& data)
+{
+  update(data.data(), data.size());
+}
+
+bytes
+Digest::Context::finish()
+{
+  auto md = bytes(_inner->output_size);
+  finish(md.data());
+  return md;
+}
+
+void
+Digest::Context::finish(uint8_t* out)
+{
+  unsigned int size = 0;
+  auto rv = (_inner->md) ? EVP_DigestFinal_ex(_inner->md.get(), out, &size)
+                         : HMAC_Final(_inner->hmac.get(), out, &size);
+  if (1 != rv) {
+    throw openssl_error();
+  }
+}
+
+// Without a new digest type or key, OpenSSL reinitializes the context with
+// the ones it already has
+void
+Digest::Context::reset()
+{
+  auto rv =
+    (_inner->md)
+      ? EVP_DigestInit_ex(_inner->md.get(), nullptr, nullptr)
+      : HMAC_Init_ex(_inner->hmac.get(), nullptr, 0, nullptr, nullptr);
+  if (1 != rv) {
+    throw openssl_error();
+  }
+}
+
+Digest::Context
+Digest::hash_context() const
+{
+  auto inner = std::make_unique<Context::Inner>(output_size);
+  inner->md = make_typed_unique(EVP_MD_CTX_new());
+  if (inner->md == nullptr) {
+    throw openssl_error();
+  }
+
+  const auto* type = openssl_digest_type(id);
+  if (1 != EVP_DigestInit_ex(inner->md.get(), type, nullptr)) {
+    throw openssl_error();
+  }
+
+  return Context(std::move(inner));
+}
+
+Digest::Context
+Digest::hmac_context(const bytes& key) const
+{
+  return keyed_hmac(key).context();
+}
+
+///
+/// Keyed HMAC
+///
+
+struct Digest::KeyedHMAC::Inner
+{
+  typed_unique_ptr<HMAC_CTX> ctx;
+  size_t output_size;
+};
+
+Digest::KeyedHMAC::KeyedHMAC(std::shared_ptr<const Inner> inner)
+  : _inner(std::move(inner))
+{}
+
+bytes
+Digest::KeyedHMAC::mac(const bytes& data) const
+{
+  auto ctx = context();
+  ctx.update(data);
+  return ctx.finish();
+}
+
+Digest::Context
+Digest::KeyedHMAC::context() const
+{
+  // Start from a copy of the keyed state, leaving the original untouched
+  auto inner = std::make_unique<Context::Inner>(_inner->output_size);
+  inner->hmac = make_typed_unique(HMAC_CTX_new());
+  if (inner->hmac == nullptr ||
+      1 != HMAC_CTX_copy(inner->hmac.get(), _inner->ctx.get())) {
+    throw openssl_error();
+  }
+
+  return Context(std::move(inner));
+}
+
+Digest::KeyedHMAC
+Digest::keyed_hmac(const bytes& key) const
+{
+  return keyed_hmac(key.data(), key.size());
+}
+
+Digest::KeyedHMAC
+Digest::keyed_hmac(const secret_bytes& key) const
+{
+  return keyed_hmac(key.data(), key.size());
+}
+
+Digest::KeyedHMAC
+Digest::keyed_hmac(const uint8_t* key, size_t key_size) const
+{
+  auto ctx = make_typed_unique(HMAC_CTX_new());
+  if (ctx == nullptr) {
+    throw openssl_error();
+  }
+
+  // OpenSSL rejects a null key pointer, even with a zero length
+  static const uint8_t empty_key = 0;
+  const auto* key_data = (key_size == 0) ? &empty_key : key;
+
+  const auto* type = openssl_digest_type(id);
+  if (1 != HMAC_Init_ex(ctx.get(), key_data, key_size, type, nullptr)) {
+    throw openssl_error();
+  }
+
+  return KeyedHMAC(
+    std::make_shared<const KeyedHMAC::Inner>(
+      KeyedHMAC::Inner{ std::move(ctx), output_size }));
+}
+
 size_t
 Digest::hash_size() const
 {
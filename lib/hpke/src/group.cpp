@@ -421,6 +421,217 @@ template<>
 const RawKeyGroup RawKeyGroup::instance<Group::ID::Ed448> =
   RawKeyGroup(Group::ID::Ed448, KDF::get<KDF::ID::HKDF_SHA512>());
 
+#if defined(HPKE_INSECURE_SIMULATION)
+///
+/// Insecure simulation of a group, for benchmarks
+///
+
+// A stand-in for a real group, with the same key, DH output and signature
+// sizes, in which every operation is a couple of HMAC calls.  It provides NO
+// security at all: the public key is a hash of the private key, the DH output
+// is a hash of the two public keys, and a signature is a hash of the public
+// key and the message, so anyone can compute any of them.  It replaces the
+// real groups only when the library is built with MLSPP_INSECURE_SIMULATION,
+// so that large groups can be simulated without the cost of real public-key
+// operations hiding everything else.
+struct SimulatedGroup : public Group
+{
+  struct PublicKey : public Group::PublicKey
+  {
+    explicit PublicKey(bytes pk_in)
+      : pk(std::move(pk_in))
+    {}
+
+    bytes pk;
+  };
+
+  struct PrivateKey : public Group::PrivateKey
+  {
+    PrivateKey(bytes sk_in, bytes pk_in)
+      : sk(std::move(sk_in))
+      , pk(std::move(pk_in))
+    {}
+
+    std::unique_ptr<Group::PublicKey> public_key() const override
+    {
+      return std::make_unique<PublicKey>(pk);
+    }
+
+    bytes sk;
+    bytes pk;
+  };
+
+  SimulatedGroup(Group::ID group_id, const KDF& kdf)
+    : Group(group_id, kdf)
+  {}
+
+  template<Group::ID id>
+  static const SimulatedGroup instance;
+
+  std::unique_ptr<Group::PrivateKey> generate_key_pair() const override
+  {
+    return deserialize_private(random_bytes(sk_size()));
+  }
+
+  std::unique_ptr<Group::PrivateKey> derive_key_pair(
+    const bytes& suite_id,
+    const bytes& ikm) const override
+  {
+    static const auto label_dkp_prk = to_bytes("dkp_prk");
+    static const auto label_sk = to_bytes("sk");
+
+    auto dkp_prk = kdf.labeled_extract(suite_id, {}, label_dkp_prk, ikm);
+    auto skm = kdf.labeled_expand(suite_id, dkp_prk, label_sk, {}, sk_size());
+    return deserialize_private(skm);
+  }
+
+  bytes serialize(const Group::PublicKey& pk) const override
+  {
+    const auto& rpk = dynamic_cast<const PublicKey&>(pk);
+    return rpk.pk;
+  }
+
+  std::unique_ptr<Group::PublicKey> deserialize(const bytes& enc) const override
+  {
+    if (enc.size() != pk_size()) {
+      throw std::runtime_error("Invalid public key");
+    }
+
+    return std::make_unique<PublicKey>(enc);
+  }
+
+  bytes serialize_private(const Group::PrivateKey& sk) const override
+  {
+    const auto& rsk = dynamic_cast<const PrivateKey&>(sk);
+    return rsk.sk;
+  }
+
+  std::unique_ptr<Group::PrivateKey> deserialize_private(
+    const bytes& skm) const override
+  {
+    static const auto label_pk = to_bytes("sim pk");
+
+    if (skm.size() != sk_size()) {
+      throw std::runtime_error("Invalid private key");
+    }
+
+    // Mark EC public keys as uncompressed points, as the real encoding does
+    auto pk = hash(label_pk, skm, pk_size());
+    if (is_ec()) {
+      pk.at(0) = 0x04;
+    }
+
+    return std::make_unique<PrivateKey>(skm, std::move(pk));
+  }
+
+  bytes dh(const Group::PrivateKey& sk,
+           const Group::PublicKey& pk) const override
+  {
+    static const auto label_dh = to_bytes("sim dh");
+
+    const auto& rsk = dynamic_cast<const PrivateKey&>(sk);
+    const auto& rpk = dynamic_cast<const PublicKey&>(pk);
+
+    // Order the two public keys so that both sides agree
+    const auto pair = (rsk.pk < rpk.pk) ? rsk.pk + rpk.pk : rpk.pk + rsk.pk;
+    return hash(label_dh, pair, dh_size());
+  }
+
+  bytes sign(const bytes& data, const Group::PrivateKey& sk) const override
+  {
+    static const auto label_sig = to_bytes("sim sig");
+
+    const auto& rsk = dynamic_cast<const PrivateKey&>(sk);
+    return hash(label_sig, rsk.pk + data, sig_size());
+  }
+
+  bool verify(const bytes& data,
+              const bytes& sig,
+              const Group::PublicKey& pk) const override
+  {
+    static const auto label_sig = to_bytes("sim sig");
+
+    const auto& rpk = dynamic_cast<const PublicKey&>(pk);
+    return sig == hash(label_sig, rpk.pk + data, sig_size());
+  }
+
+private:
+  bytes hash(const bytes& label, const bytes& data, size_t size) const
+  {
+    return kdf.expand(kdf.extract(label, data), {}, size);
+  }
+
+  bool is_ec() const
+  {
+    return id == Group::ID::P256 || id == Group::ID::P384 ||
+           id == Group::ID::P521;
+  }
+
+  // The largest signature the real algorithm produces
+  size_t sig_size() const
+  {
+    switch (id) {
+      case Group::ID::P256:
+        return 72;
+      case Group::ID::P384:
+        return 104;
+      case Group::ID::P521:
+        return 139;
+      case Group::ID::Ed25519:
+        return 64;
+      case Group::ID::Ed448:
+        return 114;
+
+      default:
+        throw std::runtime_error("Unknown or non-signature group");
+    }
+  }
+};
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::P256> =
+  SimulatedGroup(Group::ID::P256, KDF::get<KDF::ID::HKDF_SHA256>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::P384> =
+  SimulatedGroup(Group::ID::P384, KDF::get<KDF::ID::HKDF_SHA384>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::P521> =
+  SimulatedGroup(Group::ID::P521, KDF::get<KDF::ID::HKDF_SHA512>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::X25519> =
+  SimulatedGroup(Group::ID::X25519, KDF::get<KDF::ID::HKDF_SHA256>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::Ed25519> =
+  SimulatedGroup(Group::ID::Ed25519, KDF::get<KDF::ID::HKDF_SHA256>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::X448> =
+  SimulatedGroup(Group::ID::X448, KDF::get<KDF::ID::HKDF_SHA512>());
+
+template<>
+const SimulatedGroup SimulatedGroup::instance<Group::ID::Ed448> =
+  SimulatedGroup(Group::ID::Ed448, KDF::get<KDF::ID::HKDF_SHA512>());
+
+// Select the simulated group in place of the real one
+template<Group::ID id>
+static const Group&
+provider(const Group& /* real */)
+{
+  return SimulatedGroup::instance<id>;
+}
+#else
+template<Group::ID id>
+static const Group&
+provider(const Group& real)
+{
+  return real;
+}
+#endif
+
 ///
 /// General DH group
 ///
@@ -429,49 +640,50 @@ template<>
 const Group&
 Group::get<Group::ID::P256>()
 {
-  return ECKeyGroup::instance<Group::ID::P256>;
+  return provider<Group::ID::P256>(ECKeyGroup::instance<Group::ID::P256>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::P384>()
 {
-  return ECKeyGroup::instance<Group::ID::P384>;
+  return provider<Group::ID::P384>(ECKeyGroup::instance<Group::ID::P384>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::P521>()
 {
-  return ECKeyGroup::instance<Group::ID::P521>;
+  return provider<Group::ID::P521>(ECKeyGroup::instance<Group::ID::P521>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::X25519>()
 {
-  return RawKeyGroup::instance<Group::ID::X25519>;
+  return provider<Group::ID::X25519>(RawKeyGroup::instance<Group::ID::X25519>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::Ed25519>()
 {
-  return RawKeyGroup::instance<Group::ID::Ed25519>;
+  return provider<Group::ID::Ed25519>(
+    RawKeyGroup::instance<Group::ID::Ed25519>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::X448>()
 {
-  return RawKeyGroup::instance<Group::ID::X448>;
+  return provider<Group::ID::X448>(RawKeyGroup::instance<Group::ID::X448>);
 }
 
 template<>
 const Group&
 Group::get<Group::ID::Ed448>()
 {
-  return RawKeyGroup::instance<Group::ID::Ed448>;
+  return provider<Group::ID::Ed448>(RawKeyGroup::instance<Group::ID::Ed448>);
 }
 
 size_t
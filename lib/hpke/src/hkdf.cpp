@@ -4,6 +4,8 @@
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+
+#include <algorithm>
 #include <stdexcept>
 
 namespace hpke {
@@ -74,23 +76,86 @@ HKDF::extract(const bytes& salt, const bytes& ikm) const
 }
 
 bytes
-HKDF::expand(const bytes& prk, const bytes& info, size_t size) const
+HKDF::extract(const secret_bytes& salt, const bytes& ikm) const
+{
+  return digest.hmac(salt, ikm);
+}
+
+// Each block T(i) = HMAC(PRK, T(i-1) | info | i) is computed in a secret
+// buffer and copied straight to the output, so the intermediate blocks are
+// zeroized rather than left on the heap
+static void
+expand_with(const Digest::KeyedHMAC& prk,
+            size_t hash_size,
+            const bytes& info,
+            uint8_t* out,
+            size_t size)
 {
-  auto okm = bytes{};
+  auto block = secret_bytes{};
+  block.resize(hash_size);
+
   auto i = uint8_t(0x00);
-  auto Ti = bytes{};
-  while (okm.size() < size) {
+  for (size_t offset = 0; offset < size; offset += hash_size) {
+    auto ctx = prk.context();
+    if (i > 0) {
+      ctx.update(block.data(), block.size());
+    }
+
     i += 1;
-    auto block = Ti + info + bytes{ i };
+    ctx.update(info);
+    ctx.update(&i, 1);
+    ctx.finish(block.data());
 
-    Ti = digest.hmac(prk, block);
-    okm += Ti;
+    auto count = std::min(hash_size, size - offset);
+    std::copy(block.begin(), block.begin() + count, out + offset);
   }
+}
 
-  okm.resize(size);
+bytes
+HKDF::expand(const bytes& prk, const bytes& info, size_t size) const
+{
+  auto okm = bytes(size);
+  expand_with(digest.keyed_hmac(prk), hash_size(), info, okm.data(), size);
   return okm;
 }
 
+struct HKDFExpander : public KDF::Expander
+{
+  HKDFExpander(Digest::KeyedHMAC prk_in, size_t hash_size_in)
+    : prk(std::move(prk_in))
+    , hash_size(hash_size_in)
+  {}
+
+  bytes expand(const bytes& info, size_t size) const override
+  {
+    auto okm = bytes(size);
+    expand_with(prk, hash_size, info, okm.data(), size);
+    return okm;
+  }
+
+  void expand(const bytes& info, size_t size, secret_bytes& out) const override
+  {
+    out.resize(size);
+    expand_with(prk, hash_size, info, out.data(), size);
+  }
+
+private:
+  Digest::KeyedHMAC prk;
+  size_t hash_size;
+};
+
+std::unique_ptr<KDF::Expander>
+HKDF::expander(const bytes& prk) const
+{
+  return std::make_unique<HKDFExpander>(digest.keyed_hmac(prk), hash_size());
+}
+
+std::unique_ptr<KDF::Expander>
+HKDF::expander(const secret_bytes& prk) const
+{
+  return std::make_unique<HKDFExpander>(digest.keyed_hmac(prk), hash_size());
+}
+
 size_t
 HKDF::hash_size() const
 {
@@ -13,7 +13,10 @@ struct HKDF : public KDF
   ~HKDF() override = default;
 
   bytes extract(const bytes& salt, const bytes& ikm) const override;
+  bytes extract(const secret_bytes& salt, const bytes& ikm) const override;
   bytes expand(const bytes& prk, const bytes& info, size_t size) const override;
+  std::unique_ptr<Expander> expander(const bytes& prk) const override;
+  std::unique_ptr<Expander> expander(const secret_bytes& prk) const override;
   size_t hash_size() const override;
 
 private:
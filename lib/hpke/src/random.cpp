@@ -2,17 +2,235 @@
 
 #include "openssl_common.h"
 
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 #include <openssl/rand.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace hpke {
 
+static int
+current_pid()
+{
+#ifdef _WIN32
+  return _getpid();
+#else
+  return static_cast<int>(getpid());
+#endif
+}
+
+static void
+shared_random(uint8_t* data, size_t size)
+{
+  if (1 != RAND_bytes(data, static_cast<int>(size))) {
+    throw openssl_error();
+  }
+}
+
+///
+/// Configuration
+///
+
+// The options are published with a version number, so that each thread only
+// takes the lock to read them when they have changed
+static std::mutex config_mutex;
+static ThreadRandomOptions config_options;
+static std::atomic<bool> config_enabled{ false };
+static std::atomic<uint64_t> config_version{ 0 };
+
+void
+enable_thread_random(const ThreadRandomOptions& options)
+{
+  if (options.buffer_size == 0 || options.max_request > options.buffer_size) {
+    throw std::invalid_argument("Invalid random buffer size");
+  }
+
+  auto lock = std::lock_guard<std::mutex>(config_mutex);
+  config_options = options;
+  config_version += 1;
+  config_enabled = true;
+}
+
+void
+disable_thread_random()
+{
+  auto lock = std::lock_guard<std::mutex>(config_mutex);
+  config_enabled = false;
+  config_version += 1;
+}
+
+///
+/// Per-thread generator
+///
+
+class ThreadRandom
+{
+public:
+  ThreadRandom()
+    : _ctx(make_typed_unique(EVP_CIPHER_CTX_new()))
+  {
+    if (_ctx == nullptr) {
+      throw openssl_error();
+    }
+  }
+
+  ~ThreadRandom() { OPENSSL_cleanse(_buffer.data(), _buffer.size()); }
+
+  ThreadRandom(const ThreadRandom& other) = delete;
+  ThreadRandom& operator=(const ThreadRandom& other) = delete;
+
+  // Returns false if the request should go to the shared generator instead
+  bool generate(uint8_t* data, size_t size)
+  {
+    auto version = config_version.load();
+    if (version != _version) {
+      auto lock = std::lock_guard<std::mutex>(config_mutex);
+      _options = config_options;
+      _version = config_version;
+      _seeded = false;
+    }
+
+    if (size > _options.max_request) {
+      return false;
+    }
+
+    if (needs_reseed()) {
+      reseed();
+    }
+
+    while (size > 0) {
+      if (_offset == _buffer.size()) {
+        refill();
+      }
+
+      auto n = std::min(size, _buffer.size() - _offset);
+      auto* start = _buffer.data() + _offset;
+      std::copy(start, start + n, data);
+      OPENSSL_cleanse(start, n);
+
+      _offset += n;
+      data += n;
+      size -= n;
+    }
+
+    return true;
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+  static constexpr size_t key_size = 32;
+
+  // The reseed interval is only checked against the clock once in this many
+  // requests, so that most requests do not read the clock
+  static constexpr size_t clock_check_interval = 64;
+
+  typed_unique_ptr<EVP_CIPHER_CTX> _ctx;
+  std::vector<uint8_t> _buffer;
+  size_t _offset = 0;
+
+  uint64_t _version = std::numeric_limits<uint64_t>::max();
+  ThreadRandomOptions _options;
+
+  bool _seeded = false;
+  size_t _since_reseed = 0;
+  clock::time_point _seeded_at;
+  size_t _until_clock_check = 0;
+  int _pid = 0;
+
+  bool needs_reseed()
+  {
+    if (!_seeded || _since_reseed >= _options.reseed_bytes) {
+      return true;
+    }
+
+    if (_options.fork_safe && current_pid() != _pid) {
+      return true;
+    }
+
+    if (_until_clock_check > 0) {
+      _until_clock_check -= 1;
+      return false;
+    }
+
+    _until_clock_check = clock_check_interval;
+    return clock::now() - _seeded_at >= _options.reseed_interval;
+  }
+
+  void rekey(const uint8_t* key)
+  {
+    static const auto iv = std::array<uint8_t, 16>{};
+    if (1 != EVP_EncryptInit_ex(
+               _ctx.get(), EVP_chacha20(), nullptr, key, iv.data())) {
+      throw openssl_error();
+    }
+  }
+
+  // Start over from a fresh key, discarding any buffered output
+  void reseed()
+  {
+    auto key = std::array<uint8_t, key_size>{};
+    shared_random(key.data(), key.size());
+    rekey(key.data());
+    OPENSSL_cleanse(key.data(), key.size());
+
+    OPENSSL_cleanse(_buffer.data(), _buffer.size());
+    _buffer.resize(_options.buffer_size);
+    _offset = _buffer.size();
+
+    _seeded = true;
+    _since_reseed = 0;
+    _seeded_at = clock::now();
+    _until_clock_check = clock_check_interval;
+    _pid = current_pid();
+  }
+
+  // Generate the next block of keystream.  The first bytes become the next
+  // key, and the rest are buffered for output.
+  void refill()
+  {
+    auto block = std::vector<uint8_t>(key_size + _buffer.size(), 0);
+    auto out_size = 0;
+    if (1 != EVP_EncryptUpdate(_ctx.get(),
+                               block.data(),
+                               &out_size,
+                               block.data(),
+                               static_cast<int>(block.size()))) {
+      throw openssl_error();
+    }
+
+    rekey(block.data());
+    std::copy(block.begin() + key_size, block.end(), _buffer.begin());
+    OPENSSL_cleanse(block.data(), block.size());
+
+    _offset = 0;
+    _since_reseed += _buffer.size();
+  }
+};
+
 bytes
 random_bytes(size_t size)
 {
   auto rand = bytes(size);
-  if (1 != RAND_bytes(rand.data(), size)) {
-    throw openssl_error();
+  if (config_enabled.load(std::memory_order_relaxed)) {
+    thread_local auto generator = ThreadRandom();
+    if (generator.generate(rand.data(), size)) {
+      return rand;
+    }
   }
+
+  shared_random(rand.data(), size);
   return rand;
 }
 
@@ -87,6 +87,13 @@ TEST_CASE("AEAD Known-Answer")
 
     auto decrypted = aead.open(tc.key, tc.nonce, tc.aad, tc.ciphertext);
     CHECK(decrypted == tc.plaintext);
+
+    // A keyed context gives the same answers, including when reused
+    auto keyed = aead.keyed(tc.key);
+    for (int i = 0; i < 2; i++) {
+      CHECK(keyed->seal(tc.nonce, tc.aad, tc.plaintext) == tc.ciphertext);
+      CHECK(keyed->open(tc.nonce, tc.aad, tc.ciphertext) == tc.plaintext);
+    }
   }
 }
 
@@ -107,5 +114,48 @@ TEST_CASE("AEAD Round-Trip")
     auto encrypted = aead.seal(key, nonce, aad, plaintext);
     auto decrypted = aead.open(key, nonce, aad, encrypted);
     CHECK(decrypted == plaintext);
+
+    // A key and nonce held in secret_bytes are used in place
+    auto secret_key = secret_bytes(key);
+    auto secret_nonce = secret_bytes(nonce);
+    CHECK(aead.seal(secret_key, secret_nonce, aad, plaintext) == encrypted);
+    CHECK(aead.open(secret_key, secret_nonce, aad, encrypted) == plaintext);
+    CHECK(aead.keyed(secret_key)->open(nonce, aad, encrypted) == plaintext);
+
+    auto short_key = secret_bytes(bytes(aead.key_size() - 1, 0xA0));
+    CHECK_THROWS(aead.seal(short_key, secret_nonce, aad, plaintext));
+    CHECK_THROWS(aead.keyed(short_key));
+  }
+}
+
+TEST_CASE("AEAD Keyed Context")
+{
+  const std::vector<AEAD::ID> ids{ AEAD::ID::AES_128_GCM,
+                                   AEAD::ID::AES_256_GCM,
+                                   AEAD::ID::CHACHA20_POLY1305 };
+
+  const auto aad = from_hex("04050607");
+
+  for (const auto& id : ids) {
+    const auto& aead = select_aead(id);
+    auto key = bytes(aead.key_size(), 0xA0);
+    auto keyed = aead.keyed(key);
+
+    for (uint8_t i = 0; i < 4; i++) {
+      auto nonce = bytes(aead.nonce_size(), i);
+      auto plaintext = bytes(size_t(i) * 10, i);
+
+      auto encrypted = keyed->seal(nonce, aad, plaintext);
+      CHECK(encrypted == aead.seal(key, nonce, aad, plaintext));
+      CHECK(keyed->open(nonce, aad, encrypted) == plaintext);
+
+      // A failed open does not disturb later operations
+      auto corrupted = encrypted;
+      corrupted.back() ^= 0xff;
+      CHECK_THROWS(keyed->open(nonce, aad, corrupted));
+      CHECK(keyed->open(nonce, aad, encrypted) == plaintext);
+    }
+
+    CHECK_THROWS(aead.keyed(bytes(aead.key_size() + 1)));
   }
 }
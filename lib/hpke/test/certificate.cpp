@@ -7,6 +7,8 @@
 #include <iostream>
 #include <vector>
 
+// Certificates are not supported in an insecure simulation build
+#if !defined(HPKE_INSECURE_SIMULATION)
 TEST_CASE("Certificate Known-Answer depth 2")
 {
   // TODO(suhas) Do this for each supported signature algorithm
@@ -57,3 +59,4 @@ TEST_CASE("Certificate Known-Answer depth 2")
   CHECK_FALSE(root.valid_from(issuing));
   CHECK_FALSE(root.valid_from(leaf));
 }
+#endif // !defined(HPKE_INSECURE_SIMULATION)
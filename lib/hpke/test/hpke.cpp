@@ -4,6 +4,9 @@
 #include "common.h"
 #include "test_vectors.h"
 
+// The simulated groups in an insecure simulation build do not reproduce the
+// real algorithms' outputs
+#if !defined(HPKE_INSECURE_SIMULATION)
 static void
 test_context(ReceiverContext& ctxR, const HPKETestVector& tv)
 {
@@ -113,6 +116,7 @@ TEST_CASE("HPKE Test Vectors")
     }
   }
 }
+#endif // !defined(HPKE_INSECURE_SIMULATION)
 
 TEST_CASE("HPKE Round-Trip")
 {
@@ -1,4 +1,5 @@
 #include <doctest/doctest.h>
+#include <hpke/digest.h>
 #include <hpke/hpke.h>
 
 #include "common.h"
@@ -74,6 +75,23 @@ TEST_CASE("KDF Known-Answer")
     auto expanded = kdf.expand(extracted, info, expand_size);
     CHECK(expanded == tc.expanded);
 
+    // An expander gives the same output, however many times it is used
+    auto expander = kdf.expander(extracted);
+    CHECK(expander->expand(info, expand_size) == tc.expanded);
+    CHECK(expander->expand(info, expand_size) == tc.expanded);
+
+    auto prefix = bytes(expanded.begin(), expanded.begin() + 5);
+    CHECK(expander->expand(info, prefix.size()) == prefix);
+
+    // Secrets held in secret_bytes give the same outputs, written in place
+    CHECK(kdf.extract(secret_bytes(salt), ikm) == tc.extracted);
+    auto secret_expander = kdf.expander(secret_bytes(extracted));
+    auto secret_out = secret_bytes{};
+    secret_expander->expand(info, expand_size, secret_out);
+    CHECK(secret_out == secret_bytes(tc.expanded));
+    secret_expander->expand(info, prefix.size(), secret_out);
+    CHECK(secret_out == secret_bytes(prefix));
+
     auto labeled_extracted = kdf.labeled_extract(tc.suite_id, salt, label, ikm);
     CHECK(labeled_extracted == tc.labeled_extracted);
 
@@ -82,3 +100,58 @@ TEST_CASE("KDF Known-Answer")
     CHECK(labeled_expanded == tc.labeled_expanded);
   }
 }
+
+TEST_CASE("Keyed HMAC")
+{
+  const auto data = from_hex("00010203");
+  const auto keys = std::vector<bytes>{
+    {},
+    from_hex("0b0b0b0b"),
+    bytes(200, 0xA0), // Longer than the block size, so hashed first
+  };
+
+  const auto& digest = Digest::get<Digest::ID::SHA256>();
+  for (const auto& key : keys) {
+    auto keyed = digest.keyed_hmac(key);
+    auto copy = keyed;
+    CHECK(keyed.mac(data) == digest.hmac(key, data));
+    CHECK(keyed.mac(data) == digest.hmac(key, data));
+    CHECK(copy.mac(data + key) == digest.hmac(key, data + key));
+  }
+}
+
+TEST_CASE("Incremental Digest")
+{
+  const auto prefix = from_hex("00010203");
+  const auto suffix = from_hex("04050607");
+  const auto key = from_hex("0b0b0b0b");
+
+  const auto& digest = Digest::get<Digest::ID::SHA384>();
+  auto hash = digest.hash_context();
+  auto hmac = digest.hmac_context(key);
+  hash.update(prefix);
+  hmac.update(prefix);
+
+  // A copy taken mid-stream continues independently of the original
+  auto hash_copy = hash;
+  auto hmac_copy = hmac;
+  hash.update(suffix);
+  hmac.update(suffix);
+
+  CHECK(hash.finish() == digest.hash(prefix + suffix));
+  CHECK(hmac.finish() == digest.hmac(key, prefix + suffix));
+  CHECK(hash_copy.finish() == digest.hash(prefix));
+  CHECK(hmac_copy.finish() == digest.hmac(key, prefix));
+
+  // A reset context starts over with the same hash function and key
+  hash.reset();
+  hmac.reset();
+  hash.update(suffix);
+  hmac.update(suffix);
+
+  auto out = bytes(digest.hash_size());
+  hash.finish(out.data());
+  CHECK(out == digest.hash(suffix));
+  hmac.finish(out.data());
+  CHECK(out == digest.hmac(key, suffix));
+}
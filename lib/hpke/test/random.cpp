@@ -1,9 +1,38 @@
 #include <doctest/doctest.h>
 #include <hpke/random.h>
 
+#include <algorithm>
+#include <vector>
+
 TEST_CASE("Random bytes")
 {
   auto size = size_t(128);
   auto test_val = hpke::random_bytes(size);
   CHECK(test_val.size() == size);
 }
+
+TEST_CASE("Per-thread random bytes")
+{
+  auto options = hpke::ThreadRandomOptions{};
+  options.buffer_size = 64;
+  options.max_request = 48;
+  options.reseed_bytes = 256;
+  hpke::enable_thread_random(options);
+
+  // Requests that fit in the buffer, span refills, or bypass it
+  auto seen = std::vector<bytes>{};
+  for (auto size : { 0, 1, 16, 48, 40, 32, 100, 48, 48, 48, 48, 48 }) {
+    auto val = hpke::random_bytes(size);
+    CHECK(val.size() == size_t(size));
+    if (size >= 16) {
+      CHECK(std::find(seen.begin(), seen.end(), val) == seen.end());
+      seen.push_back(val);
+    }
+  }
+
+  options.max_request = 128;
+  CHECK_THROWS_AS(hpke::enable_thread_random(options), std::invalid_argument);
+
+  hpke::disable_thread_random();
+  CHECK(hpke::random_bytes(32).size() == 32);
+}
@@ -5,6 +5,9 @@
 
 #include <vector>
 
+// The simulated groups in an insecure simulation build do not reproduce the
+// real algorithms' outputs
+#if !defined(HPKE_INSECURE_SIMULATION)
 TEST_CASE("Signature Known-Answer")
 {
   struct KnownAnswerTest
@@ -79,6 +82,7 @@ TEST_CASE("Signature Known-Answer")
     CHECK(sig.verify(tc.data, tc.signature, *pub));
   }
 }
+#endif // !defined(HPKE_INSECURE_SIMULATION)
 
 TEST_CASE("Signature Round-Trip")
 {
@@ -100,3 +104,38 @@ TEST_CASE("Signature Round-Trip")
     CHECK(sig.verify(data, signature, *pub));
   }
 }
+
+#if defined(HPKE_INSECURE_SIMULATION)
+TEST_CASE("Simulated Signature")
+{
+  const std::vector<Signature::ID> ids{
+    Signature::ID::P256_SHA256, Signature::ID::P384_SHA384,
+    Signature::ID::P521_SHA512, Signature::ID::Ed25519,
+    Signature::ID::Ed448,
+  };
+
+  const auto data = from_hex("00010203");
+  const auto other_data = from_hex("04050607");
+
+  for (const auto& id : ids) {
+    const auto& sig = select_signature(id);
+
+    auto priv = sig.generate_key_pair();
+    auto pub = priv->public_key();
+    auto other_priv = sig.generate_key_pair();
+    auto other_pub = other_priv->public_key();
+
+    // Signing is deterministic and verification binds the key and the data
+    auto signature = sig.sign(data, *priv);
+    CHECK(signature == sig.sign(data, *priv));
+    CHECK(sig.verify(data, signature, *pub));
+    CHECK_FALSE(sig.verify(other_data, signature, *pub));
+    CHECK_FALSE(sig.verify(data, signature, *other_pub));
+
+    // Keys survive serialization
+    auto pub_data = sig.serialize(*pub);
+    auto pub_parsed = sig.deserialize(pub_data);
+    CHECK(sig.verify(data, signature, *pub_parsed));
+  }
+}
+#endif // defined(HPKE_INSECURE_SIMULATION)
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <tls/tls_syntax.h>
+#include <utility>
+
+namespace tls {
+
+///
+/// frame_layout
+///
+
+// The shape of a message on the wire, as far as is needed to find where it
+// ends: a sequence of fixed-size fields and length-prefixed vectors.
+class frame_layout
+{
+public:
+  struct field
+  {
+    int head;    // Length of the vector header, or 0 for a fixed-size field
+    size_t size; // Size of a fixed-size field
+  };
+
+  frame_layout& add_fixed(size_t size);
+  frame_layout& add_vector(int head);
+
+  const std::vector<field>& fields() const { return _fields; }
+
+  // Derive the layout of a serializable struct from its fields and traits.
+  // Every field must either have a fixed size and pass-through traits, or be
+  // a vector with a length header.
+  template<typename T>
+  static frame_layout of()
+  {
+    static_assert(is_serializable<T>::value, "Type is not serializable");
+    using fields = decltype(std::declval<const T&>()._tls_fields_w());
+
+    auto layout = frame_layout();
+    layout.add_fields<T, fields>(
+      std::make_index_sequence<std::tuple_size<fields>::value>());
+    return layout;
+  }
+
+private:
+  std::vector<field> _fields;
+
+  template<typename T, size_t I, bool = has_traits<T>::value>
+  struct field_traits
+  {
+    using type = pass;
+  };
+
+  template<typename T, size_t I>
+  struct field_traits<T, I, true>
+  {
+    using type = std::tuple_element_t<I, typename T::_tls_traits>;
+  };
+
+  template<typename Traits>
+  struct vector_head : std::integral_constant<size_t, 0>
+  {};
+
+  template<size_t head, size_t min, size_t max>
+  struct vector_head<vector<head, min, max>>
+    : std::integral_constant<size_t, head>
+  {};
+
+  template<typename T, typename Fields, size_t... I>
+  void add_fields(std::index_sequence<I...> /* unused */)
+  {
+    (add_field<std::decay_t<std::tuple_element_t<I, Fields>>,
+               typename field_traits<T, I>::type>(),
+     ...);
+  }
+
+  template<typename F, typename Traits>
+  void add_field()
+  {
+    if constexpr (vector_head<Traits>::value > 0) {
+      add_vector(vector_head<Traits>::value);
+    } else {
+      static_assert(std::is_same<Traits, pass>::value && fixed_size<F>::fixed,
+                    "Field length cannot be determined from its header");
+      add_fixed(fixed_size<F>::size);
+    }
+  }
+};
+
+///
+/// frame
+///
+
+// A complete message, as a list of slices of the chunks it was received in.
+// The frame holds references to those chunks, so they stay alive as long as
+// the frame does.
+class frame
+{
+public:
+  using chunk = std::shared_ptr<const std::vector<uint8_t>>;
+
+  struct slice
+  {
+    chunk source;
+    size_t offset;
+    size_t size;
+
+    const uint8_t* data() const { return source->data() + offset; }
+  };
+
+  frame(std::vector<slice> slices, size_t size);
+
+  size_t size() const { return _size; }
+  const std::vector<slice>& slices() const { return _slices; }
+
+  // A copy of the frame as a single buffer
+  std::vector<uint8_t> bytes() const;
+
+  // Decode the frame.  A frame that lies within one chunk is decoded in
+  // place; only a frame that spans chunks is first copied together.
+  template<typename T>
+  T get() const
+  {
+    T value;
+    if (_slices.size() == 1) {
+      istream r(_slices.front().data(), _slices.front().size);
+      r >> value;
+      return value;
+    }
+
+    auto data = bytes();
+    istream r(data);
+    r >> value;
+    return value;
+  }
+
+private:
+  std::vector<slice> _slices;
+  size_t _size;
+};
+
+///
+/// frame_decoder
+///
+
+// An incremental decoder that splits a byte stream, received in arbitrary
+// chunks, into messages with a given layout.  Chunks are held by reference
+// until every frame that covers them has been read; they are never copied
+// into a reassembly buffer.
+class frame_decoder
+{
+public:
+  using chunk = frame::chunk;
+
+  frame_decoder(frame_layout layout,
+                size_t max_size = std::numeric_limits<size_t>::max());
+
+  void push(chunk data);
+  void push(std::vector<uint8_t>&& data);
+
+  // The next complete frame, if one has been received.  Throws ReadError if
+  // the frame would be larger than the maximum size.
+  std::optional<frame> next();
+
+  // The number of bytes received but not yet returned in a frame
+  size_t buffered() const { return _buffered; }
+
+private:
+  frame_layout _layout;
+  size_t _max_size;
+
+  std::deque<chunk> _chunks;
+  size_t _offset = 0;   // Read position in the first chunk
+  size_t _buffered = 0; // Bytes available from the read position
+
+  // Progress in measuring the current frame, so that bytes are not rescanned
+  // when a frame arrives over several chunks
+  size_t _field = 0;
+  size_t _frame_size = 0;
+
+  uint64_t read_header(size_t position, int length) const;
+  frame take(size_t size);
+};
+
+} // namespace tls
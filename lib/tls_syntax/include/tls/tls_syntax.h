@@ -2,8 +2,12 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <map>
 #include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -38,13 +42,96 @@ class ostream
 public:
   static const size_t none = -1;
 
+  ostream() = default;
+
+  void reserve(size_t size) { _buffer.reserve(size); }
   void write_raw(const std::vector<uint8_t>& bytes);
+  void write_raw(const uint8_t* data, size_t size);
+
+  // The number of bytes written to the stream so far
+  size_t size() const
+  {
+    return _count_only ? _count : _buffer.size() + _gathered_size + _flushed;
+  }
+
+  // The encoded bytes can be moved out of an ostream that is no longer needed,
+  // e.g., `return std::move(w).bytes();`
+  const std::vector<uint8_t>& bytes() const&;
+  std::vector<uint8_t> bytes() &&;
+
+  // In gather mode, byte vectors of at least `threshold` bytes are not copied
+  // into the stream.  The stream records a reference to the caller's data
+  // instead, so that data must outlive the stream and must not be modified.
+  // The output of a gathering stream is read as a list of segments, e.g., to
+  // be passed to writev() without assembling the whole message.
+  struct segment
+  {
+    const uint8_t* data;
+    size_t size;
+  };
+
+  static ostream gather(size_t threshold);
+  std::vector<segment> segments() const;
+
+  // A stream over a sink passes the encoded bytes on to the sink as they are
+  // produced, instead of storing them, e.g., to feed them to a hash function.
+  // Since length headers cannot be filled in after their contents have been
+  // passed on, the contents of each vector are counted before they are
+  // written.  Bytes may be held back until flush() is called.
+  struct sink
+  {
+    virtual ~sink() = default;
+    virtual void write(const uint8_t* data, size_t size) = 0;
+  };
+
+  explicit ostream(sink& out)
+    : _sink(&out)
+  {}
 
-  std::vector<uint8_t> bytes() const { return _buffer; }
+  void flush();
 
 private:
+  // A counting stream tracks how many bytes would be written, without storing
+  // them.  This is how encoded_size() is computed.
+  struct count_only_t
+  {};
+  explicit ostream(count_only_t /* unused */)
+    : _count_only(true)
+  {}
+
+  // Data referenced by a gathering stream, to be emitted before the byte at
+  // `offset` in the stream's own buffer
+  struct gathered
+  {
+    size_t offset;
+    const uint8_t* data;
+    size_t size;
+  };
+
   std::vector<uint8_t> _buffer;
+  bool _count_only = false;
+  size_t _count = 0;
+
+  size_t _gather_threshold = none;
+  std::vector<gathered> _gathered;
+  size_t _gathered_size = 0;
+
+  sink* _sink = nullptr;
+  size_t _flushed = 0;
+  static constexpr size_t sink_buffer_size = 256;
+
   ostream& write_uint(uint64_t value, int length);
+  void write_opaque(const std::vector<uint8_t>& data);
+  void truncate(size_t size);
+
+  // Length headers are written as placeholders and filled in once the length
+  // of the data they cover is known.  The returned offset is the position of
+  // the header in the stream's own buffer.
+  size_t reserve_header(int length);
+  void patch_header(size_t start, uint64_t value, int length);
+
+  template<typename T>
+  friend size_t encoded_size(const T& value);
 
   friend ostream& operator<<(ostream& out, bool data);
   friend ostream& operator<<(ostream& out, uint8_t data);
@@ -97,20 +184,34 @@ operator<<(tls::ostream& str, const T& val)
 /// istream
 ///
 
+// An istream is a cursor over a range of bytes owned by the caller.  Reading
+// advances the cursor; nested vectors are decoded from sub-ranges of the same
+// buffer, so the only copies made are into the fields being decoded.  The
+// underlying buffer must outlive the stream.
 class istream
 {
 public:
   istream(const std::vector<uint8_t>& data)
-    : _buffer(data)
-  {
-    // So that we can use the constant-time pop_back
-    std::reverse(_buffer.begin(), _buffer.end());
-  }
+    : istream(data.data(), data.size())
+  {}
+
+  istream(const uint8_t* data, size_t size)
+    : _data(data)
+    , _size(size)
+  {}
+
+  // The stream does not copy its input, so it cannot read from a temporary
+  istream(std::vector<uint8_t>&& data) = delete;
+
+  bool empty() const { return _size == 0; }
+  size_t size() const { return _size; }
 
 private:
-  istream() {}
-  std::vector<uint8_t> _buffer;
+  const uint8_t* _data;
+  size_t _size;
+
   uint8_t next();
+  const uint8_t* consume(size_t size);
 
   template<typename T>
   istream& read_uint(T& data, int length);
@@ -177,14 +278,35 @@ operator>>(tls::istream& str, T& val)
   return str;
 }
 
+// Declared below, once the serialization traits are available
+template<typename T, typename Enable = void>
+struct fixed_size;
+
+// Encoded size of a value, computed by running the same encoders as marshal()
+// over a stream that only counts bytes.  Fields of fixed-size types, and
+// vectors of them, are counted without being visited.
+template<typename T>
+size_t
+encoded_size(const T& value)
+{
+  if constexpr (fixed_size<T>::fixed) {
+    return fixed_size<T>::size;
+  }
+
+  ostream w(ostream::count_only_t{});
+  w << value;
+  return w.size();
+}
+
 // Abbreviations
 template<typename T>
 std::vector<uint8_t>
 marshal(const T& value)
 {
   ostream w;
+  w.reserve(encoded_size(value));
   w << value;
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 template<typename T>
@@ -271,6 +393,77 @@ struct pass
   }
 };
 
+// Types whose encoding has the same length for every value, so that their
+// encoded size is known at compile time:
+//
+// * Integers, booleans, and enums
+// * Arrays of fixed-size types
+// * Structs whose fields are all fixed-size and use pass-through traits
+template<typename T, typename Enable>
+struct fixed_size
+{
+  static constexpr bool fixed = false;
+  static constexpr size_t size = 0;
+};
+
+template<typename T>
+struct fixed_size<
+  T,
+  std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value>>
+{
+  static constexpr bool fixed = true;
+  static constexpr size_t size = sizeof(T);
+};
+
+template<typename T, size_t N>
+struct fixed_size<std::array<T, N>>
+{
+  static constexpr bool fixed = fixed_size<T>::fixed;
+  static constexpr size_t size = N * fixed_size<T>::size;
+};
+
+template<typename Tuple, typename Traits = void>
+struct fixed_size_fields;
+
+template<typename... Tp>
+struct fixed_size_fields<std::tuple<Tp...>, void>
+{
+  static constexpr bool fixed = (fixed_size<std::decay_t<Tp>>::fixed && ...);
+  static constexpr size_t size = (fixed_size<std::decay_t<Tp>>::size + ... + 0);
+};
+
+template<typename... Tp, typename... Tr>
+struct fixed_size_fields<std::tuple<Tp...>, std::tuple<Tr...>>
+{
+  static constexpr bool fixed =
+    fixed_size_fields<std::tuple<Tp...>>::fixed &&
+    (std::is_same<Tr, pass>::value && ...);
+  static constexpr size_t size = fixed_size_fields<std::tuple<Tp...>>::size;
+};
+
+template<typename T>
+struct fixed_size<
+  T,
+  std::enable_if_t<is_serializable<T>::value && !has_traits<T>::value>>
+  : fixed_size_fields<decltype(std::declval<const T&>()._tls_fields_w())>
+{};
+
+template<typename T>
+struct fixed_size<
+  T,
+  std::enable_if_t<is_serializable<T>::value && has_traits<T>::value>>
+  : fixed_size_fields<decltype(std::declval<const T&>()._tls_fields_w()),
+                      typename T::_tls_traits>
+{};
+
+template<typename T>
+constexpr size_t
+encoded_size()
+{
+  static_assert(fixed_size<T>::fixed, "Type does not have a fixed size");
+  return fixed_size<T>::size;
+}
+
 // Vector encoding
 template<size_t head, size_t min = none, size_t max = none>
 struct vector
@@ -304,29 +497,77 @@ struct vector
         throw WriteError("Invalid header size");
     }
 
-    // Pre-encode contents
-    ostream temp;
-    for (const auto& item : data) {
-      temp << item;
+    // A sink has no placeholder to fill in, so the length is computed first,
+    // and the contents are written after it
+    if (str._sink != nullptr) {
+      uint64_t size = 0;
+      if constexpr (fixed_size<T>::fixed) {
+        size = data.size() * fixed_size<T>::size;
+      } else {
+        ostream counter(ostream::count_only_t{});
+        for (const auto& item : data) {
+          counter << item;
+        }
+        size = counter.size();
+      }
+
+      if (const auto* message = size_error(size, head_max)) {
+        throw WriteError(message);
+      }
+
+      str.write_uint(size, head);
+      if constexpr (std::is_same_v<T, uint8_t>) {
+        str.write_opaque(data);
+      } else {
+        for (const auto& item : data) {
+          str << item;
+        }
+      }
+      return str;
     }
 
-    // Check that the encoded length is OK
-    uint64_t size = temp._buffer.size();
-    if (size > head_max) {
-      throw WriteError("Data too large for header size");
-    } else if ((max != none) && (size > max)) {
-      throw WriteError("Data too large for declared max");
-    } else if ((min != none) && (size < min)) {
-      throw WriteError("Data too small for declared min");
+    // Encode the contents directly after a placeholder for the length
+    auto start = str.size();
+    auto header = str.reserve_header(head);
+    if constexpr (std::is_same_v<T, uint8_t>) {
+      str.write_opaque(data);
+    } else if (fixed_size<T>::fixed && str._count_only) {
+      str._count += data.size() * fixed_size<T>::size;
+    } else {
+      for (const auto& item : data) {
+        str << item;
+      }
     }
 
-    // Write the encoded length, then the pre-encoded data
-    str.write_uint(size, head);
-    str.write_raw(temp.bytes());
+    // Check that the encoded length is OK, and if not, remove the partial
+    // encoding before reporting the error
+    auto fail = [&](const char* message) {
+      str.truncate(start);
+      return WriteError(message);
+    };
+
+    uint64_t size = str.size() - start - head;
+    if (const auto* message = size_error(size, head_max)) {
+      throw fail(message);
+    }
 
+    // Fill in the encoded length
+    str.patch_header(header, size, head);
     return str;
   }
 
+  static const char* size_error(uint64_t size, uint64_t head_max)
+  {
+    if (size > head_max) {
+      return "Data too large for header size";
+    } else if ((max != none) && (size > max)) {
+      return "Data too large for declared max";
+    } else if ((min != none) && (size < min)) {
+      return "Data too small for declared min";
+    }
+    return nullptr;
+  }
+
   template<typename T>
   static istream& decode(istream& str, std::vector<T>& data)
   {
@@ -343,13 +584,13 @@ struct vector
 
     // Read the size of the vector, if provided; otherwise consume all remaining
     // data in the buffer
-    uint64_t size = str._buffer.size();
+    uint64_t size = str._size;
     if (head > 0) {
       str.read_uint(size, head);
     }
 
     // Check the size against the declared constraints
-    if (size > str._buffer.size()) {
+    if (size > str._size) {
       throw ReadError("Declared size exceeds available data size");
     } else if ((max != none) && (size > max)) {
       throw ReadError("Data too large for declared max");
@@ -360,21 +601,27 @@ struct vector
     // Truncate the data buffer
     data.clear();
 
-    // Truncate the buffer to the declared length and wrap it in a
-    // new reader, then read items from it
-    // NB: Remember that we store the vector in reverse order
+    // Opaque data is copied directly out of the input buffer
+    const auto* start = str.consume(size);
+    if constexpr (std::is_same_v<T, uint8_t>) {
+      data.assign(start, start + size);
+      return str;
+    }
+
+    // Otherwise, read items from a reader over the declared sub-range.  When
+    // the items have a fixed size, their number is known up front, and the
+    // vector is allocated once.
     // NB: This requires that T be default-constructible
-    std::vector<uint8_t> trunc(str._buffer.end() - size, str._buffer.end());
-    istream r;
-    r._buffer = trunc;
-    while (r._buffer.size() > 0) {
+    if constexpr (fixed_size<T>::fixed && fixed_size<T>::size > 0) {
+      data.reserve(size / fixed_size<T>::size);
+    }
+
+    istream r(start, size);
+    while (!r.empty()) {
       data.emplace_back();
       r >> data.back();
     }
 
-    // Truncate the primary buffer
-    str._buffer.erase(str._buffer.end() - size, str._buffer.end());
-
     return str;
   }
 };
@@ -389,64 +636,118 @@ struct variant
   template<typename Tv>
   static Te value_for();
 
-  template<size_t I = 0, typename... Tp>
-  static inline typename std::enable_if<I == sizeof...(Tp), void>::type
-  write_variant(tls::ostream&, const std::variant<Tp...>&)
-  {
-    throw WriteError("Empty variant");
-  }
-
-  template<size_t I = 0, typename... Tp>
-    static inline typename std::enable_if <
-    I<sizeof...(Tp), void>::type write_variant(tls::ostream& str,
-                                               const std::variant<Tp...>& v)
+  template<typename... Tp>
+  static ostream& encode(ostream& str, const std::variant<Tp...>& data)
   {
-    using Tc = std::variant_alternative_t<I, std::variant<Tp...>>;
-    if (std::holds_alternative<Tc>(v)) {
-      str << Tc::type << std::get<I>(v);
-      return;
+    if (data.valueless_by_exception()) {
+      throw WriteError("Empty variant");
     }
 
-    write_variant<I + 1, Tp...>(str, v);
+    table<Tp...>::writers[data.index()](str, data);
+    return str;
   }
 
   template<typename... Tp>
-  static ostream& encode(ostream& str, const std::variant<Tp...>& data)
+  static istream& decode(istream& str, std::variant<Tp...>& data)
   {
-    write_variant(str, data);
+    Te target_type;
+    str >> target_type;
+    table<Tp...>::reader_for(target_type)(str, data);
     return str;
   }
 
-  template<size_t I = 0, typename... Tp>
-  static inline typename std::enable_if<I == sizeof...(Tp), void>::type
-  read_variant(tls::istream&, Te, std::variant<Tp...>&)
+private:
+  // Dispatch tables for a variant type.  Alternatives are written by index
+  // and read by looking up their type label.  The labels are defined out of
+  // line, so they are not constant expressions, and the read table is built
+  // on first use.  Labels that fit in a byte index the read table directly;
+  // wider labels are found by binary search.
+  template<typename... Tp>
+  struct table
   {
-    throw ReadError("Invalid variant type label");
-  }
+    using variant_t = std::variant<Tp...>;
+    using writer = void (*)(ostream&, const variant_t&);
+    using reader = void (*)(istream&, variant_t&);
+    using entry = std::pair<uint64_t, reader>;
+
+    template<size_t I>
+    static void write(ostream& str, const variant_t& v)
+    {
+      using Tc = std::variant_alternative_t<I, variant_t>;
+      str << Tc::type << std::get<I>(v);
+    }
 
-  template<size_t I = 0, typename... Tp>
-    static inline typename std::enable_if <
-    I<sizeof...(Tp), void>::type read_variant(tls::istream& str,
-                                              Te target_type,
-                                              std::variant<Tp...>& v)
-  {
-    using Tc = std::variant_alternative_t<I, std::variant<Tp...>>;
-    if (Tc::type == target_type) {
+    template<size_t I>
+    static void read(istream& str, variant_t& v)
+    {
       str >> v.template emplace<I>();
-      return;
     }
 
-    read_variant<I + 1>(str, target_type, v);
-  }
+    template<size_t... I>
+    static constexpr std::array<writer, sizeof...(I)> make_writers(
+      std::index_sequence<I...> /* unused */)
+    {
+      return { &write<I>... };
+    }
 
-  template<typename... Tp>
-  static istream& decode(istream& str, std::variant<Tp...>& data)
-  {
-    Te target_type;
-    str >> target_type;
-    read_variant(str, target_type, data);
-    return str;
-  }
+    static constexpr std::array<writer, sizeof...(Tp)> writers =
+      make_writers(std::index_sequence_for<Tp...>());
+
+    // Entries sorted by label.  If two alternatives share a label, the first
+    // one is used, as it would be by a linear search.
+    template<size_t... I>
+    static std::array<entry, sizeof...(I)> make_entries(
+      std::index_sequence<I...> /* unused */)
+    {
+      auto out = std::array<entry, sizeof...(I)>{ { entry{
+        static_cast<uint64_t>(std::variant_alternative_t<I, variant_t>::type),
+        &read<I> }... } };
+      std::stable_sort(
+        out.begin(), out.end(), [](const auto& lhs, const auto& rhs) {
+          return lhs.first < rhs.first;
+        });
+      return out;
+    }
+
+    static std::array<reader, 256> make_direct()
+    {
+      auto out = std::array<reader, 256>{};
+      auto entries = make_entries(std::index_sequence_for<Tp...>());
+      for (const auto& [label, fn] : entries) {
+        if (out.at(label) == nullptr) {
+          out.at(label) = fn;
+        }
+      }
+      return out;
+    }
+
+    static reader reader_for(Te label)
+    {
+      auto key = static_cast<uint64_t>(label);
+      auto fn = reader(nullptr);
+
+      if constexpr (sizeof(Te) == 1) {
+        static const auto readers = make_direct();
+        fn = readers.at(key);
+      } else {
+        static const auto readers =
+          make_entries(std::index_sequence_for<Tp...>());
+        auto it = std::lower_bound(
+          readers.begin(), readers.end(), key, [](const auto& e, uint64_t k) {
+            return e.first < k;
+          });
+        if (it != readers.end() && it->first == key) {
+          fn = it->second;
+        }
+      }
+
+      if (fn == nullptr) {
+        throw ReadError("Invalid variant type label");
+      }
+
+      return fn;
+    }
+  };
 };
 
 // Struct writer without traits (enabled by macro)
@@ -0,0 +1,160 @@
+#include <tls/framing.h>
+
+namespace tls {
+
+///
+/// frame_layout
+///
+
+frame_layout&
+frame_layout::add_fixed(size_t size)
+{
+  _fields.push_back({ 0, size });
+  return *this;
+}
+
+frame_layout&
+frame_layout::add_vector(int head)
+{
+  if (head < 1 || head > 4) {
+    throw ReadError("Invalid header size");
+  }
+
+  _fields.push_back({ head, 0 });
+  return *this;
+}
+
+///
+/// frame
+///
+
+frame::frame(std::vector<slice> slices, size_t size)
+  : _slices(std::move(slices))
+  , _size(size)
+{}
+
+std::vector<uint8_t>
+frame::bytes() const
+{
+  auto out = std::vector<uint8_t>();
+  out.reserve(_size);
+  for (const auto& slice : _slices) {
+    out.insert(out.end(), slice.data(), slice.data() + slice.size);
+  }
+  return out;
+}
+
+///
+/// frame_decoder
+///
+
+frame_decoder::frame_decoder(frame_layout layout, size_t max_size)
+  : _layout(std::move(layout))
+  , _max_size(max_size)
+{
+  if (_layout.fields().empty()) {
+    throw ReadError("Empty frame layout");
+  }
+}
+
+void
+frame_decoder::push(chunk data)
+{
+  if (!data || data->empty()) {
+    return;
+  }
+
+  _buffered += data->size();
+  _chunks.push_back(std::move(data));
+}
+
+void
+frame_decoder::push(std::vector<uint8_t>&& data)
+{
+  push(std::make_shared<const std::vector<uint8_t>>(std::move(data)));
+}
+
+std::optional<frame>
+frame_decoder::next()
+{
+  const auto& fields = _layout.fields();
+  while (_field < fields.size()) {
+    const auto& field = fields[_field];
+    if (field.head == 0) {
+      _frame_size += field.size;
+    } else {
+      if (_buffered < _frame_size + field.head) {
+        return std::nullopt;
+      }
+
+      auto size = read_header(_frame_size, field.head);
+      _frame_size += field.head + size;
+    }
+
+    if (_frame_size > _max_size) {
+      throw ReadError("Frame exceeds maximum size");
+    }
+
+    _field += 1;
+  }
+
+  if (_buffered < _frame_size) {
+    return std::nullopt;
+  }
+
+  auto out = take(_frame_size);
+  _field = 0;
+  _frame_size = 0;
+  return out;
+}
+
+uint64_t
+frame_decoder::read_header(size_t position, int length) const
+{
+  // Find the chunk where the header starts
+  auto it = _chunks.begin();
+  position += _offset;
+  while (position >= (*it)->size()) {
+    position -= (*it)->size();
+    it += 1;
+  }
+
+  // The header may itself span chunks
+  uint64_t value = 0;
+  for (int i = 0; i < length; i += 1) {
+    if (position == (*it)->size()) {
+      position = 0;
+      it += 1;
+    }
+
+    value = (value << 8U) + (*it)->at(position);
+    position += 1;
+  }
+
+  return value;
+}
+
+frame
+frame_decoder::take(size_t size)
+{
+  auto slices = std::vector<frame::slice>();
+  auto remaining = size;
+  while (remaining > 0) {
+    auto& front = _chunks.front();
+    auto available = front->size() - _offset;
+    auto slice_size = std::min(available, remaining);
+    slices.push_back({ front, _offset, slice_size });
+
+    remaining -= slice_size;
+    _offset += slice_size;
+    if (_offset == front->size()) {
+      _chunks.pop_front();
+      _offset = 0;
+    }
+  }
+
+  _buffered -= size;
+  return { std::move(slices), size };
+}
+
+} // namespace tls
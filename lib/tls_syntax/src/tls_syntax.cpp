@@ -5,18 +5,183 @@ namespace tls {
 void
 ostream::write_raw(const std::vector<uint8_t>& bytes)
 {
+  write_raw(bytes.data(), bytes.size());
+}
+
+void
+ostream::write_raw(const uint8_t* data, size_t size)
+{
+  if (_count_only) {
+    _count += size;
+    return;
+  }
+
+  // Large writes to a sink bypass the buffer
+  if (_sink != nullptr && size >= sink_buffer_size) {
+    flush();
+    _sink->write(data, size);
+    _flushed += size;
+    return;
+  }
+
   // Not sure what the default argument is here
   // NOLINTNEXTLINE(fuchsia-default-arguments)
-  _buffer.insert(_buffer.end(), bytes.begin(), bytes.end());
+  _buffer.insert(_buffer.end(), data, data + size);
+
+  if (_sink != nullptr && _buffer.size() >= sink_buffer_size) {
+    flush();
+  }
+}
+
+const std::vector<uint8_t>&
+ostream::bytes() const&
+{
+  if (!_gathered.empty()) {
+    throw WriteError("Gathered stream must be read as segments");
+  }
+
+  if (_sink != nullptr) {
+    throw WriteError("Stream output was passed to a sink");
+  }
+
+  return _buffer;
+}
+
+std::vector<uint8_t>
+ostream::bytes() &&
+{
+  if (!_gathered.empty()) {
+    throw WriteError("Gathered stream must be read as segments");
+  }
+
+  if (_sink != nullptr) {
+    throw WriteError("Stream output was passed to a sink");
+  }
+
+  return std::move(_buffer);
+}
+
+void
+ostream::flush()
+{
+  if (_sink == nullptr || _buffer.empty()) {
+    return;
+  }
+
+  _sink->write(_buffer.data(), _buffer.size());
+  _flushed += _buffer.size();
+  _buffer.clear();
+}
+
+ostream
+ostream::gather(size_t threshold)
+{
+  auto out = ostream();
+  out._gather_threshold = threshold;
+  return out;
+}
+
+std::vector<ostream::segment>
+ostream::segments() const
+{
+  auto out = std::vector<segment>();
+  out.reserve(2 * _gathered.size() + 1);
+
+  size_t offset = 0;
+  for (const auto& ref : _gathered) {
+    if (ref.offset > offset) {
+      out.push_back({ _buffer.data() + offset, ref.offset - offset });
+      offset = ref.offset;
+    }
+
+    out.push_back({ ref.data, ref.size });
+  }
+
+  if (_buffer.size() > offset) {
+    out.push_back({ _buffer.data() + offset, _buffer.size() - offset });
+  }
+
+  return out;
+}
+
+void
+ostream::write_opaque(const std::vector<uint8_t>& data)
+{
+  if (_count_only || data.size() < _gather_threshold) {
+    write_raw(data);
+    return;
+  }
+
+  _gathered.push_back({ _buffer.size(), data.data(), data.size() });
+  _gathered_size += data.size();
+}
+
+void
+ostream::truncate(size_t size)
+{
+  if (_count_only) {
+    _count = size;
+    return;
+  }
+
+  // Drop any references that start at or after the truncation point.  The
+  // remaining references all precede it, so what is left to cut is in the
+  // stream's own buffer.
+  while (!_gathered.empty()) {
+    const auto& last = _gathered.back();
+    if (last.offset + _gathered_size - last.size < size) {
+      break;
+    }
+
+    _gathered_size -= last.size;
+    _gathered.pop_back();
+  }
+
+  _buffer.resize(size - _gathered_size);
+}
+
+size_t
+ostream::reserve_header(int length)
+{
+  if (_count_only) {
+    auto start = _count;
+    _count += length;
+    return start;
+  }
+
+  auto start = _buffer.size();
+  _buffer.resize(start + length);
+  return start;
+}
+
+void
+ostream::patch_header(size_t start, uint64_t value, int length)
+{
+  if (_count_only) {
+    return;
+  }
+
+  for (int i = length - 1; i >= 0; i -= 1) {
+    _buffer[start + length - 1 - i] = value >> unsigned(8 * i);
+  }
 }
 
 // Primitive type writers
 ostream&
 ostream::write_uint(uint64_t value, int length)
 {
+  if (_count_only) {
+    _count += length;
+    return *this;
+  }
+
   for (int i = length - 1; i >= 0; i -= 1) {
     _buffer.push_back(value >> unsigned(8 * i));
   }
+
+  if (_sink != nullptr && _buffer.size() >= sink_buffer_size) {
+    flush();
+  }
   return *this;
 }
 
@@ -54,27 +219,42 @@ operator<<(ostream& out, uint64_t data)
   return out.write_uint(data, 8);
 }
 
-// Because pop_back() on an empty vector is undefined
 uint8_t
 istream::next()
 {
-  if (_buffer.empty()) {
+  if (_size == 0) {
     throw ReadError("Attempt to read from empty buffer");
   }
 
-  uint8_t value = _buffer.back();
-  _buffer.pop_back();
+  uint8_t value = *_data;
+  _data += 1;
+  _size -= 1;
   return value;
 }
 
+// Advance past the next `size` bytes, returning a pointer to the first
+const uint8_t*
+istream::consume(size_t size)
+{
+  if (size > _size) {
+    throw ReadError("Attempt to read past end of buffer");
+  }
+
+  const auto* start = _data;
+  _data += size;
+  _size -= size;
+  return start;
+}
+
 // Primitive type readers
 template<typename T>
 istream&
 istream::read_uint(T& data, int length)
 {
+  const auto* start = consume(length);
   uint64_t value = 0;
   for (int i = 0; i < length; i += 1) {
-    value = (value << unsigned(8)) + next();
+    value = (value << unsigned(8)) + start[i];
   }
   data = value;
   return *this;
@@ -0,0 +1,101 @@
+#include <bytes/bytes.h>
+#include <doctest/doctest.h>
+#include <tls/framing.h>
+
+using namespace bytes_ns;
+
+// A message with a fixed-size field and two length-prefixed vectors
+struct Message
+{
+  uint16_t id{ 0 };
+  std::vector<uint8_t> header;
+  std::vector<uint8_t> body;
+
+  TLS_SERIALIZABLE(id, header, body)
+  TLS_TRAITS(tls::pass, tls::vector<1>, tls::vector<4>)
+};
+
+bool
+operator==(const Message& lhs, const Message& rhs)
+{
+  return (lhs.id == rhs.id) && (lhs.header == rhs.header) &&
+         (lhs.body == rhs.body);
+}
+
+class FramingTest
+{
+protected:
+  const Message message1{ 0x0102, from_hex("aabb"), from_hex("cccccccc") };
+  const Message message2{ 0x0304, {}, from_hex("dd") };
+  const bytes enc_message1 = from_hex("010202aabb00000004cccccccc");
+  const bytes enc_message2 = from_hex("03040000000001dd");
+
+  const tls::frame_layout layout = tls::frame_layout::of<Message>();
+};
+
+TEST_CASE_FIXTURE(FramingTest, "Frame layout")
+{
+  const auto& fields = layout.fields();
+  REQUIRE(fields.size() == 3);
+  REQUIRE(fields[0].head == 0);
+  REQUIRE(fields[0].size == 2);
+  REQUIRE(fields[1].head == 1);
+  REQUIRE(fields[2].head == 4);
+
+  REQUIRE(tls::marshal(message1) == enc_message1);
+  REQUIRE(tls::marshal(message2) == enc_message2);
+}
+
+TEST_CASE_FIXTURE(FramingTest, "Frame decoding within chunks")
+{
+  auto decoder = tls::frame_decoder(layout);
+  decoder.push(enc_message1 + enc_message2);
+
+  auto frame1 = decoder.next();
+  REQUIRE(frame1.has_value());
+  REQUIRE(frame1->slices().size() == 1);
+  REQUIRE(frame1->bytes() == enc_message1);
+  REQUIRE(frame1->get<Message>() == message1);
+
+  auto frame2 = decoder.next();
+  REQUIRE(frame2.has_value());
+  REQUIRE(frame2->get<Message>() == message2);
+
+  // Both frames refer to the same chunk
+  REQUIRE(frame1->slices()[0].source == frame2->slices()[0].source);
+
+  REQUIRE_FALSE(decoder.next().has_value());
+  REQUIRE(decoder.buffered() == 0);
+}
+
+TEST_CASE_FIXTURE(FramingTest, "Frame decoding across chunks")
+{
+  // Deliver the stream one byte at a time
+  auto stream = enc_message1 + enc_message2;
+  auto decoder = tls::frame_decoder(layout);
+  auto frames = std::vector<tls::frame>();
+  for (const auto byte : stream) {
+    decoder.push(bytes{ byte });
+    while (auto frame = decoder.next()) {
+      frames.push_back(std::move(frame.value()));
+    }
+  }
+
+  REQUIRE(frames.size() == 2);
+  REQUIRE(frames[0].slices().size() == enc_message1.size());
+  REQUIRE(frames[0].bytes() == enc_message1);
+  REQUIRE(frames[0].get<Message>() == message1);
+  REQUIRE(frames[1].bytes() == enc_message2);
+  REQUIRE(frames[1].get<Message>() == message2);
+  REQUIRE(decoder.buffered() == 0);
+}
+
+TEST_CASE_FIXTURE(FramingTest, "Frame size limit")
+{
+  auto decoder = tls::frame_decoder(layout, enc_message1.size() - 1);
+  decoder.push(from_hex("010202aabb"));
+  REQUIRE_FALSE(decoder.next().has_value());
+
+  decoder.push(from_hex("00000004"));
+  REQUIRE_THROWS_AS(decoder.next(), tls::ReadError);
+}
@@ -189,4 +189,210 @@ TEST_CASE_FIXTURE(TLSSyntaxTest, "TLS abbreviations")
   REQUIRE(val_in == val_out2);
 }
 
+TEST_CASE_FIXTURE(TLSSyntaxTest, "TLS encoded size")
+{
+  // Fixed-size types have a size known at compile time
+  static_assert(tls::encoded_size<uint32_t>() == 4);
+  static_assert(tls::encoded_size<IntSelector>() == 2);
+  static_assert(tls::encoded_size<std::array<uint16_t, 4>>() == 8);
+  static_assert(tls::encoded_size<Uint16>() == 2);
+  static_assert(!tls::fixed_size<ExampleStruct>::fixed);
+  static_assert(!tls::fixed_size<tls::opaque<2>>::fixed);
+
+  // Other types are sized by a counting pass over the value
+  REQUIRE(tls::encoded_size(val_uint64) == enc_uint64.size());
+  REQUIRE(tls::encoded_size(val_array) == enc_array.size());
+  REQUIRE(tls::encoded_size(val_struct) == enc_struct.size());
+  REQUIRE(tls::encoded_size(val_optional) == enc_optional.size());
+  REQUIRE(tls::encoded_size(val_optional_null) == enc_optional_null.size());
+  REQUIRE(tls::encoded_size(val_opaque) == enc_opaque.size());
+
+  const auto val_vector = std::vector<Uint16>(5, Uint16{ 0x1234 });
+  tls::ostream w;
+  tls::vector<1>::encode(w, val_vector);
+  REQUIRE(w.size() == 11);
+}
+
+TEST_CASE("TLS gathered output")
+{
+  const auto small = from_hex("0102");
+  const auto large = bytes(0x20, 0xff);
+  auto expected = from_hex("02") + small + from_hex("00000020") + large;
+
+  auto w = tls::ostream::gather(0x10);
+  tls::vector<1>::encode(w, small);
+  tls::vector<4>::encode(w, large);
+  REQUIRE(w.size() == expected.size());
+  REQUIRE_THROWS_AS(w.bytes(), tls::WriteError);
+
+  // Large vectors are referenced in place, not copied
+  auto segments = w.segments();
+  REQUIRE(segments.size() == 2);
+  REQUIRE(segments[1].data == large.data());
+
+  auto joined = bytes{};
+  for (const auto& segment : segments) {
+    joined.insert(joined.end(), segment.data, segment.data + segment.size);
+  }
+  REQUIRE(joined == expected);
+
+  // A failed write removes references along with copied data
+  const auto nested = std::vector<tls::opaque<1>>{ { large } };
+  REQUIRE_THROWS_AS((tls::vector<1, tls::none, 0x10>::encode(w, nested)),
+                    tls::WriteError);
+  REQUIRE(w.size() == expected.size());
+  REQUIRE(w.segments().size() == 2);
+}
+
+// Single-byte type labels, to test variants with labels indexed directly
+enum struct ByteSelector : uint8_t
+{
+  first = 0x01,
+  second = 0xf0,
+};
+
+struct First
+{
+  uint8_t value;
+  static const ByteSelector type;
+  TLS_SERIALIZABLE(value)
+};
+
+const ByteSelector First::type = ByteSelector::first;
+
+struct Second
+{
+  uint16_t value;
+  static const ByteSelector type;
+  TLS_SERIALIZABLE(value)
+};
+
+const ByteSelector Second::type = ByteSelector::second;
+
+TEST_CASE("TLS variant labels")
+{
+  using ByteVariant = std::variant<First, Second>;
+  using WideVariant = std::variant<Uint8, Uint16>;
+
+  auto second = ByteVariant{ Second{ 0x1234 } };
+  tls::ostream w;
+  tls::variant<ByteSelector>::encode(w, second);
+  REQUIRE(w.bytes() == from_hex("f01234"));
+
+  auto decoded = ByteVariant{};
+  tls::istream r(w.bytes());
+  tls::variant<ByteSelector>::decode(r, decoded);
+  REQUIRE(std::get<Second>(decoded).value == 0x1234);
+
+  // Unknown labels are rejected for both direct and searched tables
+  const auto unknown_byte = from_hex("02ff");
+  tls::istream r_byte(unknown_byte);
+  REQUIRE_THROWS_AS(tls::variant<ByteSelector>::decode(r_byte, decoded),
+                    tls::ReadError);
+
+  const auto unknown_wide = from_hex("cccc00");
+  auto wide = WideVariant{};
+  tls::istream r_wide(unknown_wide);
+  REQUIRE_THROWS_AS(tls::variant<IntSelector>::decode(r_wide, wide),
+                    tls::ReadError);
+}
+
+// A struct to test nested vector decoding
+struct NestedStruct
+{
+  std::vector<tls::opaque<1>> items;
+  uint8_t trailer{ 0 };
+
+  TLS_SERIALIZABLE(items, trailer)
+  TLS_TRAITS(tls::vector<2>, tls::pass)
+};
+
+TEST_CASE("TLS nested vectors")
+{
+  const auto enc = from_hex("000702aaaa0002bbbbcc");
+
+  tls::istream r(enc);
+  NestedStruct val;
+  r >> val;
+  REQUIRE(r.empty());
+  REQUIRE(val.items.size() == 3);
+  REQUIRE(val.items[0].data == from_hex("aaaa"));
+  REQUIRE(val.items[1].data.empty());
+  REQUIRE(val.items[2].data == from_hex("bbbb"));
+  REQUIRE(val.trailer == 0xcc);
+
+  REQUIRE(tls::marshal(val) == enc);
+
+  // A declared length that runs past the end of the outer vector
+  const auto overrun = from_hex("000303aaaacc");
+  REQUIRE_THROWS_AS(tls::get<NestedStruct>(overrun), tls::ReadError);
+}
+
+TEST_CASE("TLS vector length errors")
+{
+  tls::ostream w;
+  w << uint8_t(0xaa);
+
+  // A vector too large for its header leaves the stream as it was
+  auto too_large = std::vector<uint8_t>(0x100, 0);
+  REQUIRE_THROWS_AS(tls::vector<1>::encode(w, too_large), tls::WriteError);
+  REQUIRE(w.bytes() == from_hex("aa"));
+
+  tls::vector<1>::encode(w, from_hex("bbcc"));
+  REQUIRE(std::move(w).bytes() == from_hex("aa02bbcc"));
+}
+
+// A sink that records each write it receives
+struct RecordingSink : public tls::ostream::sink
+{
+  std::vector<bytes> writes;
+
+  void write(const uint8_t* data, size_t size) override
+  {
+    writes.emplace_back(data, data + size);
+  }
+
+  bytes joined() const
+  {
+    auto out = bytes{};
+    for (const auto& write : writes) {
+      out.insert(out.end(), write.begin(), write.end());
+    }
+    return out;
+  }
+};
+
+TEST_CASE("TLS sink output")
+{
+  const auto val =
+    NestedStruct{ { { from_hex("aaaa") }, { bytes(0xf0, 0xbb) } }, 0xcc };
+  const auto large = bytes(0x200, 0xdd);
+  const auto expected =
+    tls::marshal(val) + from_hex("0200") + large + tls::marshal(val);
+
+  RecordingSink sink;
+  tls::ostream w(sink);
+  w << val;
+  tls::vector<2>::encode(w, large);
+  w << val;
+  w.flush();
+  REQUIRE(w.size() == expected.size());
+  REQUIRE(sink.joined() == expected);
+  REQUIRE_THROWS_AS(w.bytes(), tls::WriteError);
+
+  // Large vectors are passed to the sink directly, not copied into the buffer
+  REQUIRE(sink.writes.size() == 3);
+  REQUIRE(sink.writes[1] == large);
+
+  // Length errors are found before anything is written
+  RecordingSink failed_sink;
+  tls::ostream failed(failed_sink);
+  const auto nested = std::vector<tls::opaque<1>>{ { bytes(0x10, 0) } };
+  REQUIRE_THROWS_AS((tls::vector<1, tls::none, 0x10>::encode(failed, nested)),
+                    tls::WriteError);
+  failed.flush();
+  REQUIRE(failed.size() == 0);
+  REQUIRE(failed_sink.writes.empty());
+}
+
 // TODO(rlb@ipv.sx) Test failure cases
@@ -64,7 +64,9 @@ KeyPackage::KeyPackage(CipherSuite suite_in,
 bytes
 KeyPackage::hash() const
 {
-  return cipher_suite.get().digest.hash(tls::marshal(*this));
+  HashStream hash(cipher_suite);
+  hash.stream() << *this;
+  return hash.digest();
 }
 
 void
@@ -112,7 +114,7 @@ KeyPackage::to_be_signed() const
 {
   tls::ostream out;
   out << version << cipher_suite << init_key << credential;
-  return out.bytes();
+  return std::move(out).bytes();
 }
 
 bool
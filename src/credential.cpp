@@ -122,6 +122,19 @@ Credential::public_key() const
   throw std::bad_variant_access();
 }
 
+const bytes&
+Credential::identity() const
+{
+  switch (_cred.index()) {
+    case 0:
+      return std::get<BasicCredential>(_cred).identity;
+    case 1:
+      return std::get<X509Credential>(_cred).der_chain.at(0).data;
+  }
+
+  throw std::bad_variant_access();
+}
+
 bool
 Credential::valid_for(const SignaturePrivateKey& priv) const
 {
@@ -1,6 +1,8 @@
 #include "mls/crypto.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <string>
 
 using hpke::AEAD;      // NOLINT(misc-unused-using-decls)
@@ -103,31 +105,92 @@ CipherSuite::get() const
   }
 }
 
-struct HKDFLabel
+///
+/// KDFLabel
+///
+
+KDFLabel::KDFLabel(const std::string& label)
 {
-  uint16_t length;
-  bytes label;
-  bytes context;
+  static const auto prefix = std::string("mls10 ");
 
-  TLS_SERIALIZABLE(length, label, context)
-  TLS_TRAITS(tls::pass, tls::vector<1>, tls::vector<4>)
-};
+  auto size = prefix.size() + label.size();
+  if (size > std::numeric_limits<uint8_t>::max()) {
+    throw InvalidParameterError("KDF label too long");
+  }
+
+  _encoded.reserve(1 + size);
+  _encoded.push_back(static_cast<uint8_t>(size));
+  _encoded.insert(_encoded.end(), prefix.begin(), prefix.end());
+  _encoded.insert(_encoded.end(), label.begin(), label.end());
+}
+
+KDFLabel::KDFLabel(const char* label)
+  : KDFLabel(std::string(label))
+{}
+
+const KDFLabel KDFLabel::app_key("app-key");
+const KDFLabel KDFLabel::app_nonce("app-nonce");
+const KDFLabel KDFLabel::app_secret("app-secret");
+const KDFLabel KDFLabel::hs_secret("hs-secret");
+const KDFLabel KDFLabel::tree("tree");
+const KDFLabel KDFLabel::path("path");
+const KDFLabel KDFLabel::sender_data("sender data");
+const KDFLabel KDFLabel::sd_key("sd key");
+const KDFLabel KDFLabel::handshake("handshake");
+const KDFLabel KDFLabel::app("app");
+const KDFLabel KDFLabel::exporter("exporter");
+const KDFLabel KDFLabel::confirm("confirm");
+const KDFLabel KDFLabel::init("init");
+const KDFLabel KDFLabel::group_info("group info");
+const KDFLabel KDFLabel::key("key");
+const KDFLabel KDFLabel::nonce("nonce");
+
+// The TLS encoding of the HKDFLabel struct, written directly into a buffer of
+// the right size:
+//
+//   struct {
+//     uint16 length = Length;
+//     opaque label<7..255> = "mls10 " + Label;
+//     opaque context<0..2^32-1> = Context;
+//   } HKDFLabel;
+static bytes
+hkdf_label(const KDFLabel& label,
+           const uint8_t* context,
+           size_t context_size,
+           size_t length)
+{
+  if (context_size > std::numeric_limits<uint32_t>::max()) {
+    throw InvalidParameterError("KDF context too long");
+  }
+
+  const auto& encoded = label.encoded();
+  auto info = bytes(2 + encoded.size() + 4 + context_size);
+  auto* out = info.data();
+
+  *out++ = static_cast<uint8_t>(length >> 8U);
+  *out++ = static_cast<uint8_t>(length);
+  out = std::copy(encoded.begin(), encoded.end(), out);
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    *out++ = static_cast<uint8_t>(context_size >> unsigned(shift));
+  }
+  std::copy(context, context + context_size, out);
+
+  return info;
+}
 
 bytes
 CipherSuite::expand_with_label(const bytes& secret,
-                               const std::string& label,
+                               const KDFLabel& label,
                                const bytes& context,
                                size_t length) const
 {
-  auto mls_label = to_bytes(std::string("mls10 ") + label);
-  auto length16 = static_cast<uint16_t>(length);
-  auto label_bytes = tls::marshal(HKDFLabel{ length16, mls_label, context });
-  return get().hpke.kdf.expand(secret, label_bytes, length);
+  auto info = hkdf_label(label, context.data(), context.size(), length);
+  return get().hpke.kdf.expand(secret, info, length);
 }
 
 bytes
 CipherSuite::derive_secret(const bytes& secret,
-                           const std::string& label,
+                           const KDFLabel& label,
                            const bytes& context) const
 {
   auto context_hash = get().digest.hash(context);
@@ -135,6 +198,90 @@ CipherSuite::derive_secret(const bytes& secret,
   return expand_with_label(secret, label, context_hash, size);
 }
 
+CipherSuite::Expander
+CipherSuite::expander(const bytes& secret) const
+{
+  return { *this, get().hpke.kdf.expander(secret) };
+}
+
+CipherSuite::Expander
+CipherSuite::expander(const secret_bytes& secret) const
+{
+  return { *this, get().hpke.kdf.expander(secret) };
+}
+
+CipherSuite::Expander::Expander(CipherSuite suite,
+                                std::unique_ptr<hpke::KDF::Expander> prk)
+  : _suite(suite)
+  , _prk(std::move(prk))
+{}
+
+bytes
+CipherSuite::Expander::expand_with_label(const KDFLabel& label,
+                                         const bytes& context,
+                                         size_t length) const
+{
+  return expand_with_label(label, context.data(), context.size(), length);
+}
+
+bytes
+CipherSuite::Expander::expand_with_label(const KDFLabel& label,
+                                         const uint8_t* context,
+                                         size_t context_size,
+                                         size_t length) const
+{
+  return _prk->expand(hkdf_label(label, context, context_size, length), length);
+}
+
+void
+CipherSuite::Expander::expand_with_label(const KDFLabel& label,
+                                         const uint8_t* context,
+                                         size_t context_size,
+                                         size_t length,
+                                         secret_bytes& out) const
+{
+  _prk->expand(hkdf_label(label, context, context_size, length), length, out);
+}
+
+bytes
+CipherSuite::Expander::derive_secret(const KDFLabel& label,
+                                     const bytes& context) const
+{
+  auto context_hash = _suite.get().digest.hash(context);
+  auto size = _suite.get().digest.hash_size();
+  return expand_with_label(label, context_hash, size);
+}
+
+///
+/// HashStream
+///
+
+HashStream::HashStream(CipherSuite suite)
+  : _ctx(suite.get().digest.hash_context())
+  , _stream(*this)
+{}
+
+bytes
+HashStream::digest()
+{
+  _stream.flush();
+  return _ctx.finish();
+}
+
+void
+HashStream::digest_into(uint8_t* out)
+{
+  _stream.flush();
+  _ctx.finish(out);
+  _ctx.reset();
+}
+
+void
+HashStream::write(const uint8_t* data, size_t size)
+{
+  _ctx.update(data, size);
+}
+
 const std::array<CipherSuite::ID, 6> all_supported_suites = {
   CipherSuite::ID::X25519_AES128GCM_SHA256_Ed25519,
   CipherSuite::ID::P256_AES128GCM_SHA256_P256,
@@ -167,12 +314,17 @@ constant_time_eq(const bytes& lhs, const bytes& rhs)
 ///
 /// HPKEPublicKey and HPKEPrivateKey
 ///
+HPKEPublicKey::HPKEPublicKey(bytes data_in)
+  : data(std::move(data_in))
+{}
+
 HPKECiphertext
 HPKEPublicKey::encrypt(CipherSuite suite,
                        const bytes& aad,
                        const bytes& pt) const
 {
-  auto pkR = suite.get().hpke.kem.deserialize(data);
+  const auto& kem = suite.get().hpke.kem;
+  auto pkR = _parsed.get(suite, data, [&]() { return kem.deserialize(data); });
   auto [enc, ctx] = suite.get().hpke.setup_base_s(*pkR, {});
   auto ct = ctx.seal(aad, pt);
   return HPKECiphertext{ enc, ct };
@@ -185,7 +337,11 @@ HPKEPrivateKey::generate(CipherSuite suite)
   auto priv_data = suite.get().hpke.kem.serialize_private(*priv);
   auto pub = priv->public_key();
   auto pub_data = suite.get().hpke.kem.serialize(*pub);
-  return HPKEPrivateKey(priv_data, pub_data);
+
+  auto out = HPKEPrivateKey(priv_data, pub_data);
+  out._parsed.set(suite, out.data, std::move(priv));
+  out.public_key._parsed.set(suite, out.public_key.data, std::move(pub));
+  return out;
 }
 
 HPKEPrivateKey
@@ -204,7 +360,11 @@ HPKEPrivateKey::derive(CipherSuite suite, const bytes& secret)
   auto priv_data = suite.get().hpke.kem.serialize_private(*priv);
   auto pub = priv->public_key();
   auto pub_data = suite.get().hpke.kem.serialize(*pub);
-  return HPKEPrivateKey(priv_data, pub_data);
+
+  auto out = HPKEPrivateKey(priv_data, pub_data);
+  out._parsed.set(suite, out.data, std::move(priv));
+  out.public_key._parsed.set(suite, out.public_key.data, std::move(pub));
+  return out;
 }
 
 bytes
@@ -212,7 +372,9 @@ HPKEPrivateKey::decrypt(CipherSuite suite,
                         const bytes& aad,
                         const HPKECiphertext& ct) const
 {
-  auto skR = suite.get().hpke.kem.deserialize_private(data);
+  const auto& kem = suite.get().hpke.kem;
+  auto skR =
+    _parsed.get(suite, data, [&]() { return kem.deserialize_private(data); });
   auto ctx = suite.get().hpke.setup_base_r(ct.kem_output, *skR, {});
   auto pt = ctx.open(aad, ct.ciphertext);
   if (!pt.has_value()) {
@@ -230,13 +392,18 @@ HPKEPrivateKey::HPKEPrivateKey(bytes priv_data, bytes pub_data)
 ///
 /// SignaturePublicKey and SignaturePrivateKey
 ///
+SignaturePublicKey::SignaturePublicKey(bytes data_in)
+  : data(std::move(data_in))
+{}
+
 bool
 SignaturePublicKey::verify(const CipherSuite& suite,
                            const bytes& message,
                            const bytes& signature) const
 {
-  auto pub = suite.get().sig.deserialize(data);
-  return suite.get().sig.verify(message, signature, *pub);
+  const auto& sig = suite.get().sig;
+  auto pub = _parsed.get(suite, data, [&]() { return sig.deserialize(data); });
+  return sig.verify(message, signature, *pub);
 }
 
 SignaturePrivateKey
@@ -246,7 +413,11 @@ SignaturePrivateKey::generate(CipherSuite suite)
   auto priv_data = suite.get().sig.serialize_private(*priv);
   auto pub = priv->public_key();
   auto pub_data = suite.get().sig.serialize(*pub);
-  return SignaturePrivateKey(priv_data, pub_data);
+
+  auto out = SignaturePrivateKey(priv_data, pub_data);
+  out._parsed.set(suite, out.data, std::move(priv));
+  out.public_key._parsed.set(suite, out.public_key.data, std::move(pub));
+  return out;
 }
 
 SignaturePrivateKey
@@ -265,14 +436,20 @@ SignaturePrivateKey::derive(CipherSuite suite, const bytes& secret)
   auto priv_data = suite.get().sig.serialize_private(*priv);
   auto pub = priv->public_key();
   auto pub_data = suite.get().sig.serialize(*pub);
-  return SignaturePrivateKey(priv_data, pub_data);
+
+  auto out = SignaturePrivateKey(priv_data, pub_data);
+  out._parsed.set(suite, out.data, std::move(priv));
+  out.public_key._parsed.set(suite, out.public_key.data, std::move(pub));
+  return out;
 }
 
 bytes
 SignaturePrivateKey::sign(const CipherSuite& suite, const bytes& message) const
 {
-  auto priv = suite.get().sig.deserialize_private(data);
-  return suite.get().sig.sign(message, *priv);
+  const auto& sig = suite.get().sig;
+  auto priv =
+    _parsed.get(suite, data, [&]() { return sig.deserialize_private(data); });
+  return sig.sign(message, *priv);
 }
 
 SignaturePrivateKey::SignaturePrivateKey(bytes priv_data, bytes pub_data)
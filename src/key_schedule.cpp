@@ -15,29 +15,47 @@ zeroize(bytes& data) // NOLINT(google-runtime-references)
 /// Key Derivation Functions
 ///
 
-struct ApplicationContext
+// The context is the TLS encoding of the following struct, written into a
+// stack buffer rather than marshaled:
+//
+//   struct {
+//     uint32 node;
+//     uint32 generation;
+//   } ApplicationContext;
+static std::array<uint8_t, 8>
+app_context(NodeIndex node, uint32_t generation)
 {
-  NodeIndex node;
-  uint32_t generation;
-
-  ApplicationContext(NodeIndex node_in, uint32_t generation_in)
-    : node(node_in)
-    , generation(generation_in)
-  {}
-
-  TLS_SERIALIZABLE(node, generation)
-};
+  auto ctx = std::array<uint8_t, 8>{};
+  for (size_t i = 0; i < 4; i++) {
+    auto shift = 8 * (3 - i);
+    ctx.at(i) = static_cast<uint8_t>(node.val >> shift);
+    ctx.at(4 + i) = static_cast<uint8_t>(generation >> shift);
+  }
+  return ctx;
+}
 
 bytes
-derive_app_secret(CipherSuite suite,
-                  const bytes& secret,
-                  const std::string& label,
+derive_app_secret(const CipherSuite::Expander& secret,
+                  const KDFLabel& label,
                   NodeIndex node,
                   uint32_t generation,
                   size_t length)
 {
-  auto ctx = tls::marshal(ApplicationContext{ node, generation });
-  return suite.expand_with_label(secret, label, ctx, length);
+  auto ctx = app_context(node, generation);
+  return secret.expand_with_label(label, ctx.data(), ctx.size(), length);
+}
+
+// The same derivation, written in place into a secret
+void
+derive_app_secret(const CipherSuite::Expander& secret,
+                  const KDFLabel& label,
+                  NodeIndex node,
+                  uint32_t generation,
+                  size_t length,
+                  secret_bytes& out)
+{
+  auto ctx = app_context(node, generation);
+  secret.expand_with_label(label, ctx.data(), ctx.size(), length, out);
 }
 
 ///
@@ -59,21 +77,20 @@ HashRatchet::HashRatchet(CipherSuite suite_in,
 std::tuple<uint32_t, KeyAndNonce>
 HashRatchet::next()
 {
-  auto key = derive_app_secret(
-    suite, next_secret, "app-key", node, next_generation, key_size);
-  auto nonce = derive_app_secret(
-    suite, next_secret, "app-nonce", node, next_generation, nonce_size);
-  auto secret = derive_app_secret(
-    suite, next_secret, "app-secret", node, next_generation, secret_size);
-
-  auto generation = next_generation;
+  auto curr = suite.expander(next_secret);
+  auto gen = next_generation;
+  auto key_nonce = KeyAndNonce{};
+  derive_app_secret(
+    curr, KDFLabel::app_key, node, gen, key_size, key_nonce.key);
+  derive_app_secret(
+    curr, KDFLabel::app_nonce, node, gen, nonce_size, key_nonce.nonce);
+  derive_app_secret(
+    curr, KDFLabel::app_secret, node, gen, secret_size, next_secret);
 
   next_generation += 1;
-  zeroize(next_secret);
-  next_secret = secret;
 
-  cache[generation] = { key, nonce };
-  return { generation, cache[generation] };
+  cache[gen] = key_nonce;
+  return { gen, key_nonce };
 }
 
 // Note: This construction deliberately does not preserve the forward-secrecy
@@ -108,8 +125,6 @@ HashRatchet::erase(uint32_t generation)
     return;
   }
 
-  zeroize(cache[generation].key);
-  zeroize(cache[generation].nonce);
   cache.erase(generation);
 }
 
@@ -135,8 +150,11 @@ struct NoFSBaseKeySource : public BaseKeySource
 
   bytes get(LeafIndex sender) override
   {
-    return derive_app_secret(
-      suite, root_secret, "hs-secret", NodeIndex{ sender }, 0, secret_size);
+    return derive_app_secret(suite.expander(root_secret),
+                             KDFLabel::hs_secret,
+                             NodeIndex{ sender },
+                             0,
+                             secret_size);
   }
 };
 
@@ -163,42 +181,35 @@ struct TreeBaseKeySource : public BaseKeySource
 
   bytes get(LeafIndex sender) override
   {
-    // Find an ancestor that is populated
-    auto dirpath = tree_math::dirpath(NodeIndex{ sender }, width);
-    dirpath.insert(dirpath.begin(), NodeIndex{ sender });
-    dirpath.push_back(tree_math::root(width));
-    uint32_t curr = 0;
-    for (; curr < dirpath.size(); ++curr) {
-      if (!secrets[dirpath[curr].val].empty()) {
-        break;
+    // Find the lowest ancestor that is populated
+    auto leaf = NodeIndex{ sender };
+    auto node = leaf;
+    while (secrets[node.val].empty()) {
+      if (node == root) {
+        throw InvalidParameterError("No secret found to derive base key");
       }
-    }
 
-    if (curr > dirpath.size()) {
-      throw InvalidParameterError("No secret found to derive base key");
+      node = tree_math::parent(node, width);
     }
 
-    // Derive down
-    for (; curr > 0; --curr) {
-      auto node = dirpath[curr];
+    // Derive down toward the leaf, zeroizing each secret once it is used
+    while (node != leaf) {
       auto left = tree_math::left(node);
       auto right = tree_math::right(node, width);
 
-      auto& secret = secrets[node.val];
+      auto secret = suite.expander(secrets[node.val]);
       secrets[left.val] =
-        derive_app_secret(suite, secret, "tree", left, 0, secret_size);
+        derive_app_secret(secret, KDFLabel::tree, left, 0, secret_size);
       secrets[right.val] =
-        derive_app_secret(suite, secret, "tree", right, 0, secret_size);
-    }
+        derive_app_secret(secret, KDFLabel::tree, right, 0, secret_size);
+      zeroize(secrets[node.val]);
 
-    // Copy the leaf
-    auto out = secrets[NodeIndex{ sender }.val];
-
-    // Zeroize along the direct path
-    for (auto i : dirpath) {
-      zeroize(secrets[i.val]);
+      node = (leaf < node) ? left : right;
     }
 
+    // Copy the leaf
+    auto out = secrets[leaf.val];
+    zeroize(secrets[leaf.val]);
     return out;
   };
 };
@@ -275,6 +286,32 @@ GroupKeySource::erase(LeafIndex sender, uint32_t generation)
   return chain(sender).erase(generation);
 }
 
+///
+/// KeyedAEAD
+///
+
+KeyedAEAD&
+KeyedAEAD::operator=(const KeyedAEAD& other)
+{
+  if (this != &other) {
+    _ctx.reset();
+  }
+  return *this;
+}
+
+hpke::AEAD::KeyedContext&
+KeyedAEAD::get(CipherSuite suite, const secret_bytes& key)
+{
+  if (_ctx && suite.id == _suite_id && key == _key) {
+    return *_ctx;
+  }
+
+  _ctx = suite.get().hpke.aead.keyed(key);
+  _suite_id = suite.id;
+  _key = key;
+  return *_ctx;
+}
+
 ///
 /// KeyScheduleEpoch
 ///
@@ -285,18 +322,17 @@ KeyScheduleEpoch::create(CipherSuite suite,
                          const bytes& epoch_secret,
                          const bytes& context)
 {
-  auto sender_data_secret =
-    suite.derive_secret(epoch_secret, "sender data", context);
-  auto handshake_secret =
-    suite.derive_secret(epoch_secret, "handshake", context);
-  auto application_secret = suite.derive_secret(epoch_secret, "app", context);
-  auto exporter_secret = suite.derive_secret(epoch_secret, "exporter", context);
-  auto confirmation_key = suite.derive_secret(epoch_secret, "confirm", context);
-  auto init_secret = suite.derive_secret(epoch_secret, "init", context);
+  auto epoch = suite.expander(epoch_secret);
+  auto sender_data_secret = epoch.derive_secret(KDFLabel::sender_data, context);
+  auto handshake_secret = epoch.derive_secret(KDFLabel::handshake, context);
+  auto application_secret = epoch.derive_secret(KDFLabel::app, context);
+  auto exporter_secret = epoch.derive_secret(KDFLabel::exporter, context);
+  auto confirmation_key = epoch.derive_secret(KDFLabel::confirm, context);
+  auto init_secret = epoch.derive_secret(KDFLabel::init, context);
 
   auto key_size = suite.get().hpke.aead.key_size();
   auto sender_data_key =
-    suite.expand_with_label(sender_data_secret, "sd key", {}, key_size);
+    suite.expand_with_label(sender_data_secret, KDFLabel::sd_key, {}, key_size);
 
   auto handshake_base =
     std::make_unique<NoFSBaseKeySource>(suite, handshake_secret);
@@ -307,6 +343,7 @@ KeyScheduleEpoch::create(CipherSuite suite,
                            epoch_secret,
                            sender_data_secret,
                            sender_data_key,
+                           {},
                            handshake_secret,
                            GroupKeySource{ handshake_base.release() },
                            application_secret,
@@ -326,6 +363,22 @@ KeyScheduleEpoch::next(LeafCount size,
   return KeyScheduleEpoch::create(suite, size, new_epoch_secret, context);
 }
 
+bytes
+KeyScheduleEpoch::seal_sender_data(const bytes& nonce,
+                                   const bytes& aad,
+                                   const bytes& pt)
+{
+  return sender_data_aead.get(suite, sender_data_key).seal(nonce, aad, pt);
+}
+
+std::optional<bytes>
+KeyScheduleEpoch::open_sender_data(const bytes& nonce,
+                                   const bytes& aad,
+                                   const bytes& ct)
+{
+  return sender_data_aead.get(suite, sender_data_key).open(nonce, aad, ct);
+}
+
 bool
 operator==(const KeyScheduleEpoch& lhs, const KeyScheduleEpoch& rhs)
 {
@@ -40,7 +40,7 @@ GroupInfo::to_be_signed() const
   tls::vector<1>::encode(w, interim_transcript_hash);
   tls::vector<1>::encode(w, confirmation);
   w << signer_index;
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 void
@@ -80,13 +80,13 @@ Welcome::Welcome()
 {}
 
 Welcome::Welcome(CipherSuite suite,
-                 bytes epoch_secret,
+                 const secret_bytes& epoch_secret,
                  const GroupInfo& group_info)
   : version(ProtocolVersion::mls10)
   , cipher_suite(suite)
-  , _epoch_secret(std::move(epoch_secret))
+  , _epoch_secret(epoch_secret)
 {
-  auto [key, nonce] = group_info_key_nonce(_epoch_secret);
+  auto [key, nonce] = group_info_key_nonce(cipher_suite.expander(epoch_secret));
   auto group_info_data = tls::marshal(group_info);
   encrypted_group_info =
     cipher_suite.get().hpke.aead.seal(key, nonce, {}, group_info_data);
@@ -107,7 +107,7 @@ Welcome::find(const KeyPackage& kp) const
 void
 Welcome::encrypt(const KeyPackage& kp, const std::optional<bytes>& path_secret)
 {
-  auto gs = GroupSecrets{ _epoch_secret, std::nullopt };
+  auto gs = GroupSecrets{ bytes(_epoch_secret), std::nullopt };
   if (path_secret.has_value()) {
     gs.path_secret = { path_secret.value() };
   }
@@ -120,7 +120,7 @@ Welcome::encrypt(const KeyPackage& kp, const std::optional<bytes>& path_secret)
 GroupInfo
 Welcome::decrypt(const bytes& epoch_secret) const
 {
-  auto [key, nonce] = group_info_key_nonce(epoch_secret);
+  auto [key, nonce] = group_info_key_nonce(cipher_suite.expander(epoch_secret));
   auto group_info_data =
     cipher_suite.get().hpke.aead.open(key, nonce, {}, encrypted_group_info);
   if (!group_info_data.has_value()) {
@@ -131,16 +131,16 @@ Welcome::decrypt(const bytes& epoch_secret) const
 }
 
 std::tuple<bytes, bytes>
-Welcome::group_info_key_nonce(const bytes& epoch_secret) const
+Welcome::group_info_key_nonce(const CipherSuite::Expander& epoch) const
 {
   auto secret_size = cipher_suite.get().hpke.kdf.hash_size();
   auto key_size = cipher_suite.get().hpke.aead.key_size();
   auto nonce_size = cipher_suite.get().hpke.aead.nonce_size();
 
-  auto secret =
-    cipher_suite.expand_with_label(epoch_secret, "group info", {}, secret_size);
-  auto key = cipher_suite.expand_with_label(secret, "key", {}, key_size);
-  auto nonce = cipher_suite.expand_with_label(secret, "nonce", {}, nonce_size);
+  auto secret = epoch.expand_with_label(KDFLabel::group_info, {}, secret_size);
+  auto expander = cipher_suite.expander(secret);
+  auto key = expander.expand_with_label(KDFLabel::key, {}, key_size);
+  auto nonce = expander.expand_with_label(KDFLabel::nonce, {}, nonce_size);
 
   return std::make_tuple(key, nonce);
 }
@@ -250,17 +250,23 @@ MLSPlaintext::marshal_content(size_t padding_size) const
   bytes padding(padding_size, 0);
   tls::vector<2>::encode(w, signature);
   tls::vector<2>::encode(w, padding);
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 bytes
 MLSPlaintext::commit_content() const
 {
-  const auto& commit_data = std::get<CommitData>(content);
   tls::ostream w;
+  write_commit_content(w);
+  return std::move(w).bytes();
+}
+
+void
+MLSPlaintext::write_commit_content(tls::ostream& w) const
+{
+  const auto& commit_data = std::get<CommitData>(content);
   tls::vector<1>::encode(w, group_id);
   w << epoch << sender << commit_data.commit;
-  return w.bytes();
 }
 
 // struct {
@@ -270,11 +276,17 @@ MLSPlaintext::commit_content() const
 bytes
 MLSPlaintext::commit_auth_data() const
 {
-  const auto& commit_data = std::get<CommitData>(content);
   tls::ostream w;
+  write_commit_auth_data(w);
+  return std::move(w).bytes();
+}
+
+void
+MLSPlaintext::write_commit_auth_data(tls::ostream& w) const
+{
+  const auto& commit_data = std::get<CommitData>(content);
   tls::vector<1>::encode(w, commit_data.confirmation);
   tls::vector<2>::encode(w, signature);
-  return w.bytes();
 }
 
 bytes
@@ -286,7 +298,7 @@ MLSPlaintext::to_be_signed(const GroupContext& context) const
   w << epoch << sender;
   tls::vector<4>::encode(w, authenticated_data);
   tls::variant<ContentType>::encode(w, content);
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 void
@@ -307,4 +319,32 @@ MLSPlaintext::verify(const CipherSuite& suite,
   return pub.verify(suite, tbs, signature);
 }
 
+MLSCiphertextHeader
+MLSCiphertextHeader::peek(const uint8_t* data, size_t size)
+{
+  if (size < 1 || size < 1 + size_t(data[0])) {
+    throw tls::ReadError("Truncated MLSCiphertext header");
+  }
+
+  auto header =
+    MLSCiphertextHeader{ data + 1, data[0], 0, ContentType::invalid };
+  auto group_id_end = 1 + header.group_id_size;
+  auto r = tls::istream(data + group_id_end, size - group_id_end);
+  r >> header.epoch >> header.content_type;
+  return header;
+}
+
+MLSCiphertextHeader
+MLSCiphertextHeader::peek(const bytes& data)
+{
+  return peek(data.data(), data.size());
+}
+
+bool
+MLSCiphertextHeader::has_group_id(const bytes& group_id) const
+{
+  return group_id.size() == group_id_size &&
+         std::equal(group_id.begin(), group_id.end(), group_id_data);
+}
+
 } // namespace mls
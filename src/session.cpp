@@ -4,6 +4,7 @@
 #include <mls/state.h>
 
 #include <deque>
+#include <limits>
 
 namespace mls {
 
@@ -32,6 +33,7 @@ struct Session::Inner
   std::deque<State> history;
   std::optional<std::tuple<bytes, State>> outbound_cache;
   bool encrypt_handshake;
+  size_t history_limit;
 
   explicit Inner(State state);
 
@@ -47,8 +49,22 @@ struct Session::Inner
   bytes fresh_secret() const;
   bytes export_message(const MLSPlaintext& plaintext);
   MLSPlaintext import_message(const bytes& encoded);
-  void add_state(epoch_t prior_epoch, const State& group_state);
+  void add_state(epoch_t prior_epoch, State&& group_state);
+  void prune_history();
   State& for_epoch(epoch_t epoch);
+  bytes unprotect(const uint8_t* data, size_t size);
+};
+
+struct ProtectedMessage::Inner
+{
+  // Ciphertexts at least this large are referenced by the encoded message
+  // instead of being copied into it
+  static const size_t gather_threshold = 1024;
+
+  const MLSCiphertext ciphertext;
+  tls::ostream stream;
+
+  explicit Inner(MLSCiphertext ciphertext_in);
 };
 
 ///
@@ -119,6 +135,41 @@ PendingJoin::complete(const bytes& welcome) const
     inner->init_priv, inner->sig_priv, inner->key_package, welcome);
 }
 
+///
+/// ProtectedMessage
+///
+
+ProtectedMessage::Inner::Inner(MLSCiphertext ciphertext_in)
+  : ciphertext(std::move(ciphertext_in))
+  , stream(tls::ostream::gather(gather_threshold))
+{
+  stream << ciphertext;
+}
+
+ProtectedMessage::ProtectedMessage(ProtectedMessage&& other) noexcept =
+  default;
+
+ProtectedMessage&
+ProtectedMessage::operator=(ProtectedMessage&& other) noexcept = default;
+
+ProtectedMessage::~ProtectedMessage() = default;
+
+ProtectedMessage::ProtectedMessage(Inner* inner_in)
+  : inner(inner_in)
+{}
+
+size_t
+ProtectedMessage::size() const
+{
+  return inner->stream.size();
+}
+
+std::vector<tls::ostream::segment>
+ProtectedMessage::segments() const
+{
+  return inner->stream.segments();
+}
+
 ///
 /// Session
 ///
@@ -126,6 +177,7 @@ PendingJoin::complete(const bytes& welcome) const
 Session::Inner::Inner(State state)
   : history{ std::move(state) }
   , encrypt_handshake(true)
+  , history_limit(std::numeric_limits<size_t>::max())
 {}
 
 Session
@@ -184,15 +236,22 @@ Session::Inner::import_message(const bytes& encoded)
 }
 
 void
-Session::Inner::add_state(epoch_t prior_epoch, const State& state)
+Session::Inner::add_state(epoch_t prior_epoch, State&& state)
 {
   if (!history.empty() && prior_epoch != history.front().epoch()) {
     throw MissingStateError("Discontinuity in history");
   }
 
-  history.emplace_front(state);
+  history.emplace_front(std::move(state));
+  prune_history();
+}
 
-  // TODO(rlb) bound the size of the queue
+void
+Session::Inner::prune_history()
+{
+  while (history.size() > history_limit) {
+    history.pop_back();
+  }
 }
 
 State&
@@ -207,6 +266,28 @@ Session::Inner::for_epoch(epoch_t epoch)
   throw MissingStateError("No state for epoch");
 }
 
+bytes
+Session::Inner::unprotect(const uint8_t* data, size_t size)
+{
+  // Reject messages for other groups, epochs we no longer have, or that are
+  // not application data, before decoding the full message
+  auto header = MLSCiphertextHeader::peek(data, size);
+  if (!header.has_group_id(history.front().group_id())) {
+    throw ProtocolError("Ciphertext for a different group");
+  }
+
+  if (header.content_type != ContentType::application) {
+    throw ProtocolError("Unprotect of non-application message");
+  }
+
+  auto& state = for_epoch(header.epoch);
+
+  auto ciphertext = MLSCiphertext{};
+  auto r = tls::istream(data, size);
+  r >> ciphertext;
+  return state.unprotect(ciphertext);
+}
+
 Session::Session(const Session& other)
   : inner(std::make_unique<Inner>(*other.inner))
 {}
@@ -232,6 +313,17 @@ Session::encrypt_handshake(bool enabled)
   inner->encrypt_handshake = enabled;
 }
 
+void
+Session::history_limit(size_t epochs)
+{
+  if (epochs == 0) {
+    throw InvalidParameterError("History must include the current epoch");
+  }
+
+  inner->history_limit = epochs;
+  inner->prune_history();
+}
+
 bytes
 Session::add(const bytes& key_package_data)
 {
@@ -308,12 +400,12 @@ Session::handle(const bytes& handshake_data)
     }
 
     const auto& cached_msg = std::get<0>(inner->outbound_cache.value());
-    const auto& next_state = std::get<1>(inner->outbound_cache.value());
+    auto& next_state = std::get<1>(inner->outbound_cache.value());
     if (cached_msg != handshake_data) {
       throw ProtocolError("Received message different from cached");
     }
 
-    inner->add_state(handshake.epoch, next_state);
+    inner->add_state(handshake.epoch, std::move(next_state));
     inner->outbound_cache = std::nullopt;
     return true;
   }
@@ -323,10 +415,16 @@ Session::handle(const bytes& handshake_data)
     return false;
   }
 
-  inner->add_state(handshake.epoch, maybe_next_state.value());
+  inner->add_state(handshake.epoch, std::move(maybe_next_state.value()));
   return true;
 }
 
+const bytes&
+Session::group_id() const
+{
+  return inner->history.front().group_id();
+}
+
 epoch_t
 Session::current_epoch() const
 {
@@ -360,15 +458,34 @@ Session::protect(const bytes& plaintext)
   return tls::marshal(ciphertext);
 }
 
+ProtectedMessage
+Session::protect_segments(const bytes& plaintext)
+{
+  auto ciphertext = inner->history.front().protect(plaintext);
+  auto message =
+    std::make_unique<ProtectedMessage::Inner>(std::move(ciphertext));
+  return ProtectedMessage(message.release());
+}
+
 // TODO(rlb@ipv.sx): It would be good to expose identity information
 // here, since ciphertexts are authenticated per sender.  Who sent
 // this ciphertext?
 bytes
 Session::unprotect(const bytes& ciphertext)
 {
-  auto ciphertext_obj = tls::get<MLSCiphertext>(ciphertext);
-  auto& state = inner->for_epoch(ciphertext_obj.epoch);
-  return state.unprotect(ciphertext_obj);
+  return inner->unprotect(ciphertext.data(), ciphertext.size());
+}
+
+bytes
+Session::unprotect(const tls::frame& ciphertext)
+{
+  const auto& slices = ciphertext.slices();
+  if (slices.size() == 1) {
+    return inner->unprotect(slices.front().data(), slices.front().size);
+  }
+
+  auto data = ciphertext.bytes();
+  return inner->unprotect(data.data(), data.size());
 }
 
 bool
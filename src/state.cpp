@@ -264,6 +264,30 @@ State::group_context() const
   };
 }
 
+// The transcript hashes chain each Commit onto the previous transcript.  The
+// input is streamed into the hash, rather than concatenated first.
+static bytes
+confirmed_transcript_hash(CipherSuite suite,
+                          const bytes& interim_transcript_hash,
+                          const MLSPlaintext& pt)
+{
+  HashStream hash(suite);
+  hash.stream().write_raw(interim_transcript_hash);
+  pt.write_commit_content(hash.stream());
+  return hash.digest();
+}
+
+static bytes
+interim_transcript_hash(CipherSuite suite,
+                        const bytes& confirmed_transcript_hash,
+                        const MLSPlaintext& pt)
+{
+  HashStream hash(suite);
+  hash.stream().write_raw(confirmed_transcript_hash);
+  pt.write_commit_auth_data(hash.stream());
+  return hash.digest();
+}
+
 MLSPlaintext
 State::ratchet_and_sign(const Commit& op,
                         const bytes& update_secret,
@@ -272,8 +296,8 @@ State::ratchet_and_sign(const Commit& op,
   auto sender = Sender{ SenderType::member, _index.val };
   auto pt = MLSPlaintext{ _group_id, _epoch, sender, op };
 
-  auto confirmed_transcript = _interim_transcript_hash + pt.commit_content();
-  _confirmed_transcript_hash = _suite.get().digest.hash(confirmed_transcript);
+  _confirmed_transcript_hash =
+    confirmed_transcript_hash(_suite, _interim_transcript_hash, pt);
   _epoch += 1;
   update_epoch_secrets(update_secret);
 
@@ -282,8 +306,8 @@ State::ratchet_and_sign(const Commit& op,
     _keys.confirmation_key, _confirmed_transcript_hash);
   pt.sign(_suite, prev_ctx, _identity_priv);
 
-  auto interim_transcript = _confirmed_transcript_hash + pt.commit_auth_data();
-  _interim_transcript_hash = _suite.get().digest.hash(interim_transcript);
+  _interim_transcript_hash =
+    interim_transcript_hash(_suite, _confirmed_transcript_hash, pt);
 
   return pt;
 }
@@ -340,10 +364,10 @@ State::handle(const MLSPlaintext& pt)
   next._tree.merge(sender, commit_data.commit.path);
 
   // Update the transcripts and advance the key schedule
-  next._confirmed_transcript_hash = _suite.get().digest.hash(
-    next._interim_transcript_hash + pt.commit_content());
-  next._interim_transcript_hash = _suite.get().digest.hash(
-    next._confirmed_transcript_hash + pt.commit_auth_data());
+  next._confirmed_transcript_hash =
+    confirmed_transcript_hash(_suite, next._interim_transcript_hash, pt);
+  next._interim_transcript_hash =
+    interim_transcript_hash(_suite, next._confirmed_transcript_hash, pt);
 
   next._epoch += 1;
   next.update_epoch_secrets(next._tree_priv.update_secret);
@@ -384,7 +408,9 @@ State::apply(const Remove& remove)
 ProposalID
 State::proposal_id(const MLSPlaintext& pt) const
 {
-  return ProposalID{ _suite.get().digest.hash(tls::marshal(pt)) };
+  HashStream hash(_suite);
+  hash.stream() << pt;
+  return ProposalID{ hash.digest() };
 }
 
 std::optional<MLSPlaintext>
@@ -548,7 +574,7 @@ content_aad(const bytes& group_id,
   tls::vector<4>::encode(w, authenticated_data);
   tls::vector<1>::encode(w, sender_data_nonce);
   tls::vector<1>::encode(w, encrypted_sender_data);
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 // struct {
@@ -567,7 +593,7 @@ sender_data_aad(const bytes& group_id,
   tls::vector<1>::encode(w, group_id);
   w << epoch << content_type;
   tls::vector<1>::encode(w, sender_data_nonce);
-  return w.bytes();
+  return std::move(w).bytes();
 }
 
 bool
@@ -601,8 +627,9 @@ State::do_export(const std::string& label,
                  size_t size) const
 {
   // TODO(RLB): Align with latest spec
-  auto secret = _suite.derive_secret(_keys.exporter_secret, label, context);
-  return _suite.expand_with_label(secret, "exporter", context, size);
+  auto secret =
+    _suite.expander(_keys.exporter_secret).derive_secret(label, context);
+  return _suite.expand_with_label(secret, KDFLabel::exporter, context, size);
 }
 
 std::vector<Credential>
@@ -652,11 +679,8 @@ State::encrypt(const MLSPlaintext& pt)
   auto sender_data_aad_val =
     sender_data_aad(_group_id, _epoch, content_type, sender_data_nonce);
 
-  auto encrypted_sender_data =
-    _suite.get().hpke.aead.seal(_keys.sender_data_key,
-                                sender_data_nonce,
-                                sender_data_aad_val,
-                                sender_data.bytes());
+  auto encrypted_sender_data = _keys.seal_sender_data(
+    sender_data_nonce, sender_data_aad_val, sender_data.bytes());
 
   // Compute the plaintext input and AAD
   // XXX(rlb@ipv.sx): Apply padding?
@@ -699,10 +723,8 @@ State::decrypt(const MLSCiphertext& ct)
   // Decrypt and parse the sender data
   auto sender_data_aad_val = sender_data_aad(
     ct.group_id, ct.epoch, ct.content_type, ct.sender_data_nonce);
-  auto sender_data = _suite.get().hpke.aead.open(_keys.sender_data_key,
-                                                 ct.sender_data_nonce,
-                                                 sender_data_aad_val,
-                                                 ct.encrypted_sender_data);
+  auto sender_data = _keys.open_sender_data(
+    ct.sender_data_nonce, sender_data_aad_val, ct.encrypted_sender_data);
   if (!sender_data.has_value()) {
     throw ProtocolError("Sender data decryption failed");
   }
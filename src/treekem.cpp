@@ -1,5 +1,14 @@
 #include <mls/treekem.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
 namespace mls {
 
 ///
@@ -25,35 +34,74 @@ Node::public_key() const
 /// OptionalNode
 ///
 
+// struct {
+//   uint32 node_index;
+//   optional<KeyPackage> key_package;
+// } LeafNodeHashInput;
 void
-OptionalNode::set_leaf_hash(CipherSuite suite, NodeIndex index)
+OptionalNode::write_leaf_hash_input(tls::ostream& w, NodeIndex index) const
 {
-  auto leaf = std::optional<KeyPackage>{};
-  if (node.has_value()) {
-    leaf = std::get<KeyPackage>(node.value().node);
+  w << index;
+  if (!node.has_value()) {
+    w << uint8_t(0);
+    return;
   }
 
-  tls::ostream w;
-  w << index << leaf;
-  hash = suite.get().digest.hash(w.bytes());
+  w << uint8_t(1) << key_package();
 }
 
+// struct {
+//   uint32 node_index;
+//   optional<ParentNode> parent_node;
+//   opaque left_hash<0..255>;
+//   opaque right_hash<0..255>;
+// } ParentNodeHashInput;
 void
-OptionalNode::set_parent_hash(CipherSuite suite,
-                              NodeIndex index,
-                              const bytes& left,
-                              const bytes& right)
+OptionalNode::write_parent_hash_input(tls::ostream& w,
+                                      NodeIndex index,
+                                      const uint8_t* left,
+                                      const uint8_t* right,
+                                      size_t hash_size) const
 {
-  auto parent = std::optional<ParentNode>{};
-  if (node.has_value()) {
-    parent = std::get<ParentNode>(node.value().node);
+  if (hash_size > std::numeric_limits<uint8_t>::max()) {
+    throw InvalidParameterError("Child hash too large");
+  }
+
+  w << index;
+  if (!node.has_value()) {
+    w << uint8_t(0);
+  } else {
+    w << uint8_t(1) << parent_node();
+  }
+
+  w << static_cast<uint8_t>(hash_size);
+  w.write_raw(left, hash_size);
+  w << static_cast<uint8_t>(hash_size);
+  w.write_raw(right, hash_size);
+}
+
+bytes
+OptionalNode::hash_leaf(CipherSuite suite, NodeIndex index) const
+{
+  HashStream w(suite);
+  write_leaf_hash_input(w.stream(), index);
+  return w.digest();
+}
+
+bytes
+OptionalNode::hash_parent(CipherSuite suite,
+                          NodeIndex index,
+                          const bytes& left,
+                          const bytes& right) const
+{
+  if (left.size() != right.size()) {
+    throw InvalidParameterError("Child hashes differ in size");
   }
 
-  tls::ostream w;
-  w << index << parent;
-  tls::vector<1>::encode(w, left);
-  tls::vector<1>::encode(w, right);
-  hash = suite.get().digest.hash(w.bytes());
+  HashStream w(suite);
+  write_parent_hash_input(
+    w.stream(), index, left.data(), right.data(), left.size());
+  return w.digest();
 }
 
 ///
@@ -101,7 +149,7 @@ bytes
 TreeKEMPrivateKey::path_step(const bytes& path_secret) const
 {
   auto secret_size = suite.get().digest.hash_size();
-  return suite.expand_with_label(path_secret, "path", {}, secret_size);
+  return suite.expand_with_label(path_secret, KDFLabel::path, {}, secret_size);
 }
 
 void
@@ -138,7 +186,7 @@ TreeKEMPrivateKey::private_key(NodeIndex n) const
     return std::nullopt;
   }
 
-  return HPKEPrivateKey::derive(suite, i->second);
+  return HPKEPrivateKey::derive(suite, bytes(i->second));
 }
 
 bool
@@ -174,7 +222,7 @@ TreeKEMPrivateKey::shared_path_secret(LeafIndex to) const
     return std::make_tuple(n, bytes{}, false);
   }
 
-  return std::make_tuple(n, i->second, true);
+  return std::make_tuple(n, bytes(i->second), true);
 }
 
 void
@@ -186,7 +234,7 @@ TreeKEMPrivateKey::decap(LeafIndex from,
   // Identify which node in the path secret we will be decrypting
   auto ni = NodeIndex(index);
   auto size = NodeCount(pub.size());
-  auto dp = tree_math::dirpath(NodeIndex(from), size);
+  auto dp = tree_math::DirpathRange(NodeIndex(from), size);
   if (dp.size() != path.nodes.size()) {
     throw ProtocolError("Malformed direct path");
   }
@@ -195,22 +243,32 @@ TreeKEMPrivateKey::decap(LeafIndex from,
   auto last = NodeIndex(from);
   NodeIndex overlap_node;
   NodeIndex copath_node;
-  for (dpi = 0; dpi < dp.size(); dpi++) {
-    if (tree_math::in_path(ni, dp[dpi])) {
-      overlap_node = dp[dpi];
+  for (auto n : dp) {
+    if (tree_math::in_path(ni, n)) {
+      overlap_node = n;
       copath_node = tree_math::sibling(last, size);
       break;
     }
 
-    last = dp[dpi];
+    last = n;
+    dpi += 1;
   }
 
-  if (dpi == dp.size()) {
+  if (dpi == path.nodes.size()) {
     throw ProtocolError("No overlap in path");
   }
 
-  // Identify which node in the resolution of the copath we will use to decrypt
-  auto res = pub.resolve(copath_node);
+  // Identify which node in the resolution of the copath we will use to decrypt.
+  // A tree without a resolution index, e.g., one just deserialized, is
+  // resolved directly rather than indexed here.
+  auto unindexed = std::vector<NodeIndex>{};
+  auto res = NodeSpan(nullptr, nullptr);
+  if (pub.resolutions_valid()) {
+    res = pub.resolution(copath_node);
+  } else {
+    unindexed = pub.resolve(copath_node);
+    res = NodeSpan(unindexed.data(), unindexed.data() + unindexed.size());
+  }
   if (res.size() != path.nodes[dpi].node_secrets.size()) {
     throw ProtocolError("Malformed direct path node");
   }
@@ -301,6 +359,31 @@ TreeKEMPrivateKey::consistent(const TreeKEMPublicKey& other) const
   return true;
 }
 
+///
+/// TreeHashOptions
+///
+
+static auto tree_hash_options_mutex = std::mutex();
+static auto current_tree_hash_options = TreeHashOptions{};
+
+void
+set_tree_hash_options(const TreeHashOptions& options)
+{
+  if (options.threads == 0) {
+    throw InvalidParameterError("Tree hashing needs at least one thread");
+  }
+
+  const auto lock = std::lock_guard<std::mutex>(tree_hash_options_mutex);
+  current_tree_hash_options = options;
+}
+
+TreeHashOptions
+tree_hash_options()
+{
+  const auto lock = std::lock_guard<std::mutex>(tree_hash_options_mutex);
+  return current_tree_hash_options;
+}
+
 ///
 /// TreeKEMPublicKey
 ///
@@ -318,17 +401,31 @@ TreeKEMPublicKey::add_leaf(const KeyPackage& kp)
     index.val++;
   }
 
-  // Extend the tree if necessary
+  // Extend the tree if necessary.  The new nodes are all on the new leaf's
+  // direct path, so they are updated along with it.
   auto ni = NodeIndex(index);
   if (index.val >= size().val) {
+    const auto hashes_were_valid = hashes_valid();
+    const auto resolutions_were_valid = resolutions_valid();
+    const auto leaves_were_indexed = leaf_index_valid();
     nodes.resize(ni.val + 1);
+    if (hashes_were_valid) {
+      _hashes.resize(nodes.size() * suite.get().digest.hash_size());
+    }
+    if (resolutions_were_valid) {
+      _res_ranges.resize(nodes.size(), { 0, 0 });
+    }
+    if (leaves_were_indexed) {
+      _leaf_index_width = nodes.size();
+    }
   }
 
   // Set the leaf
   node_at(ni).node = Node{ kp };
+  index_leaf(index);
 
   // Update the unmerged list
-  for (auto& n : tree_math::dirpath(ni, NodeCount(size()))) {
+  for (auto n : tree_math::DirpathRange(ni, NodeCount(size()))) {
     if (!node_at(n).node.has_value()) {
       continue;
     }
@@ -338,6 +435,7 @@ TreeKEMPublicKey::add_leaf(const KeyPackage& kp)
   }
 
   clear_hash_path(index);
+  update_resolutions(index);
   return index;
 }
 
@@ -346,7 +444,9 @@ TreeKEMPublicKey::update_leaf(LeafIndex index, const KeyPackage& kp)
 {
   blank_path(index);
   node_at(NodeIndex(index)).node = Node{ kp };
+  index_leaf(index);
   clear_hash_path(index);
+  update_resolutions(index);
 }
 
 void
@@ -357,51 +457,88 @@ TreeKEMPublicKey::blank_path(LeafIndex index)
   }
 
   auto ni = NodeIndex(index);
+  unindex_leaf(index);
   node_at(ni).node.reset();
-  for (auto n : tree_math::dirpath(ni, NodeCount(size()))) {
+  for (auto n : tree_math::DirpathRange(ni, NodeCount(size()))) {
     node_at(n).node.reset();
   }
 
   clear_hash_path(index);
+  update_resolutions(index);
 }
 
 void
 TreeKEMPublicKey::merge(LeafIndex from, const DirectPath& path)
 {
   auto ni = NodeIndex(from);
+  unindex_leaf(from);
   node_at(ni).node = Node{ path.leaf_key_package };
+  index_leaf(from);
 
-  auto dp = tree_math::dirpath(ni, NodeCount(size()));
+  auto dp = tree_math::DirpathRange(ni, NodeCount(size()));
   if (dp.size() != path.nodes.size()) {
     throw ProtocolError("Malformed direct path");
   }
 
-  for (size_t i = 0; i < dp.size(); i++) {
-    auto n = dp[i];
+  size_t i = 0;
+  for (auto n : dp) {
     node_at(n).node = { ParentNode{ path.nodes[i].public_key, {}, {} } };
+    i += 1;
   }
 
   clear_hash_path(from);
+  update_resolutions(from);
   set_hash_all();
 }
 
+// Only the dirty nodes are hashed, in order of level, so that every child is
+// hashed before its parent.  The hash input of each node is streamed into one
+// digest context, which writes the hash directly into the hash array.
 void
 TreeKEMPublicKey::set_hash_all()
 {
-  auto r = tree_math::root(NodeCount(size()));
-  get_hash(r);
+  if (nodes.empty()) {
+    return;
+  }
+
+  // A tree that arrived without an index, e.g., in a Welcome, gets one here,
+  // so that it is kept up to date as the tree changes from then on
+  if (!resolutions_valid()) {
+    rebuild_resolutions();
+  }
+
+  const auto width = NodeCount(static_cast<uint32_t>(nodes.size()));
+  const auto hash_size = suite.get().digest.hash_size();
+  if (!hashes_valid()) {
+    hash_all(width, hash_size);
+    return;
+  }
+
+  std::sort(_dirty.begin(), _dirty.end(), [](NodeIndex a, NodeIndex b) {
+    return tree_math::level(a) < tree_math::level(b);
+  });
+
+  HashStream w(suite);
+  for (auto index : _dirty) {
+    hash_node(w, index, width, hash_size);
+    _is_dirty[index.val] = false;
+  }
+
+  _dirty.clear();
 }
 
 bytes
 TreeKEMPublicKey::root_hash() const
 {
   auto r = tree_math::root(NodeCount(size()));
-  auto hash = node_at(r).hash;
-  if (hash.empty()) {
+  auto dirty = r.val < _is_dirty.size() && _is_dirty[r.val];
+  if (!hashes_valid() || dirty) {
     throw InvalidParameterError("Root hash not set");
   }
 
-  return hash;
+  const auto hash_size = _hashes.size() / nodes.size();
+  const auto* hash = _hashes.data() + r.val * hash_size;
+  return bytes(hash, hash + hash_size);
 }
 
 LeafCount
@@ -413,6 +550,12 @@ TreeKEMPublicKey::size() const
 std::vector<NodeIndex>
 TreeKEMPublicKey::resolve(NodeIndex index) const
 {
+  if (resolutions_valid()) {
+    const auto& range = _res_ranges.at(index.val);
+    const auto* begin = _res_pool.data() + range.offset;
+    return std::vector<NodeIndex>(begin, begin + range.size);
+  }
+
   if (nodes[index.val].node.has_value()) {
     const auto& node = nodes[index.val].node.value();
     auto out = std::vector<NodeIndex>{ index };
@@ -440,22 +583,88 @@ TreeKEMPublicKey::resolve(NodeIndex index) const
   return l;
 }
 
-std::optional<LeafIndex>
-TreeKEMPublicKey::find(const KeyPackage& kp) const
+template<typename F>
+static std::optional<LeafIndex>
+leftmost_leaf(LeafCount size, const F& matches)
 {
-  for (LeafIndex i{ 0 }; i < size(); i.val++) {
-    const auto& node = node_at(NodeIndex(i)).node;
-    if (!node.has_value()) {
+  for (LeafIndex i{ 0 }; i < size; i.val++) {
+    if (matches(i)) {
+      return i;
+    }
+  }
+
+  return std::nullopt;
+}
+
+template<typename Map, typename F>
+static std::optional<LeafIndex>
+leftmost_leaf(const Map& index, const bytes& key, const F& matches)
+{
+  auto out = std::optional<LeafIndex>{};
+  auto [begin, end] = index.equal_range(key);
+  for (auto it = begin; it != end; ++it) {
+    if (out.has_value() && !(it->second < out.value())) {
       continue;
     }
 
-    const auto& node_kp = std::get<KeyPackage>(node.value().node);
-    if (kp == node_kp) {
-      return i;
+    if (matches(it->second)) {
+      out = it->second;
     }
   }
 
-  return std::nullopt;
+  return out;
+}
+
+std::optional<LeafIndex>
+TreeKEMPublicKey::find(const KeyPackage& kp)
+{
+  if (!leaf_index_valid()) {
+    rebuild_leaf_index();
+  }
+
+  return static_cast<const TreeKEMPublicKey&>(*this).find(kp);
+}
+
+std::optional<LeafIndex>
+TreeKEMPublicKey::find(const KeyPackage& kp) const
+{
+  const auto matches = [&](LeafIndex i) {
+    const auto& node = node_at(i);
+    return node.node.has_value() && node.key_package() == kp;
+  };
+
+  if (!leaf_index_valid()) {
+    return leftmost_leaf(size(), matches);
+  }
+
+  // Check the whole KeyPackage, in case of a hash collision
+  return leftmost_leaf(_kp_index, kp.hash(), matches);
+}
+
+std::optional<LeafIndex>
+TreeKEMPublicKey::find_by_identity(const bytes& identity)
+{
+  if (!leaf_index_valid()) {
+    rebuild_leaf_index();
+  }
+
+  return static_cast<const TreeKEMPublicKey&>(*this).find_by_identity(
+    identity);
+}
+
+std::optional<LeafIndex>
+TreeKEMPublicKey::find_by_identity(const bytes& identity) const
+{
+  if (!leaf_index_valid()) {
+    return leftmost_leaf(size(), [&](LeafIndex i) {
+      const auto& node = node_at(i);
+      return node.node.has_value() &&
+             node.key_package().credential.identity() == identity;
+    });
+  }
+
+  return leftmost_leaf(
+    _identity_index, identity, [](LeafIndex /* unused */) { return true; });
 }
 
 std::optional<KeyPackage>
@@ -489,17 +698,22 @@ TreeKEMPublicKey::encap(LeafIndex from,
   auto priv = TreeKEMPrivateKey::create(suite, size(), from, leaf_secret);
 
   // Package into a DirectPath
+  if (!resolutions_valid()) {
+    rebuild_resolutions();
+  }
+
   auto last = NodeIndex(from);
-  for (auto n : tree_math::dirpath(NodeIndex(from), NodeCount(size()))) {
+  auto dp = tree_math::DirpathRange(NodeIndex(from), NodeCount(size()));
+  for (auto n : dp) {
     auto path_secret = priv.path_secrets.at(n);
     auto node_priv = priv.private_key(n).value();
     auto node = RatchetNode{ node_priv.public_key, {} };
 
     auto copath = tree_math::sibling(last, NodeCount(size()));
-    auto res = resolve(copath);
+    auto res = resolution(copath);
     for (auto nr : res) {
       const auto& node_pub = node_at(nr).node.value().public_key();
-      auto ct = node_pub.encrypt(suite, context, path_secret);
+      auto ct = node_pub.encrypt(suite, context, bytes(path_secret));
       node.node_secrets.push_back(ct);
     }
 
@@ -519,45 +733,396 @@ TreeKEMPublicKey::encap(LeafIndex from,
 void
 TreeKEMPublicKey::truncate()
 {
+  const auto hashes_were_valid = hashes_valid();
+  const auto resolutions_were_valid = resolutions_valid();
+  const auto leaves_were_indexed = leaf_index_valid();
+  const auto original_size = nodes.size();
   while (!nodes.empty() && !nodes.back().node.has_value()) {
     nodes.pop_back();
   }
+
+  if (nodes.size() == original_size) {
+    return;
+  }
+
+  // Forget the removed nodes
+  if (hashes_were_valid && !nodes.empty()) {
+    _hashes.resize(nodes.size() * suite.get().digest.hash_size());
+    _is_dirty.resize(nodes.size());
+
+    const auto removed = [&](NodeIndex n) { return n.val >= nodes.size(); };
+    _dirty.erase(std::remove_if(_dirty.begin(), _dirty.end(), removed),
+                 _dirty.end());
+  } else {
+    clear_hash_all();
+  }
+
+  if (resolutions_were_valid) {
+    for (auto i = nodes.size(); i < original_size; i++) {
+      _res_live -= _res_ranges[i].size;
+    }
+    _res_ranges.resize(nodes.size());
+  } else {
+    _res_ranges.clear();
+    _res_pool.clear();
+    _res_live = 0;
+  }
+
+  // Only blank leaves were removed, and they are not in the index
+  if (leaves_were_indexed) {
+    _leaf_index_width = nodes.size();
+  }
+
+  // The parents on the new right edge of the tree have new right children
+  if (!nodes.empty()) {
+    const auto last = LeafIndex{ size().val - 1 };
+    clear_hash_path(last);
+    update_resolutions(last);
+  }
 }
 
 void
-TreeKEMPublicKey::clear_hash_all()
+TreeKEMPublicKey::hash_node(HashStream& w,
+                            NodeIndex index,
+                            NodeCount width,
+                            size_t hash_size)
+{
+  auto* hashes = _hashes.data();
+  const auto& node = node_at(index);
+  if (tree_math::level(index) == 0) {
+    node.write_leaf_hash_input(w.stream(), index);
+  } else {
+    const auto* lh = hashes + tree_math::left(index).val * hash_size;
+    const auto* rh = hashes + tree_math::right(index, width).val * hash_size;
+    node.write_parent_hash_input(w.stream(), index, lh, rh, hash_size);
+  }
+
+  w.digest_into(hashes + index.val * hash_size);
+}
+
+// A block is the subtree under one node on the split level.  Its nodes are
+// hashed bottom-up, without reference to any node outside it.
+void
+TreeKEMPublicKey::hash_subtree(HashStream& w,
+                               uint32_t block,
+                               uint32_t split_level,
+                               NodeCount width,
+                               size_t hash_size)
+{
+  const auto block_size = uint64_t(2) << split_level;
+  const auto start = block * block_size;
+  const auto end = std::min<uint64_t>(start + block_size, width.val);
+  for (uint32_t level = 0; level <= split_level; level++) {
+    const auto first = start + (uint64_t(1) << level) - 1;
+    const auto step = uint64_t(2) << level;
+    for (auto i = first; i < end; i += step) {
+      hash_node(w, NodeIndex{ static_cast<uint32_t>(i) }, width, hash_size);
+    }
+  }
+}
+
+// Hash every node in the tree.  The subtrees below the split level are
+// independent, so they are shared out among the threads, each of which takes
+// the next subtree whenever it is free.  With one thread, the split level is
+// the root's level and the whole tree is one subtree.
+void
+TreeKEMPublicKey::hash_all(NodeCount width, size_t hash_size)
+{
+  _hashes.resize(width.val * hash_size);
+  _dirty.clear();
+
+  const auto options = tree_hash_options();
+  const auto root_level = tree_math::level(tree_math::root(width));
+  auto split_level = root_level;
+  auto threads = size_t(1);
+  if (options.threads > 1 &&
+      LeafCount(width).val >= options.parallel_threshold) {
+    // About eight subtrees per thread, so that the load evens out
+    const auto max_threads = std::min<size_t>(options.threads, 0x10000);
+    const auto spread = tree_math::log2(uint32_t(max_threads)) + 4;
+    split_level = (root_level > spread) ? root_level - spread : 0;
+    threads = max_threads;
+  }
+
+  const auto block_size = uint64_t(2) << split_level;
+  const auto blocks =
+    static_cast<uint32_t>((width.val + block_size - 1) / block_size);
+  threads = std::min<size_t>(threads, blocks);
+
+  // The first error stops every thread, and is rethrown once they are done
+  auto next = std::atomic<uint32_t>(0);
+  auto error = std::exception_ptr();
+  auto error_mutex = std::mutex();
+  auto worker = [&]() {
+    try {
+      HashStream w(suite);
+      for (auto block = next++; block < blocks; block = next++) {
+        hash_subtree(w, block, split_level, width, hash_size);
+      }
+    } catch (...) {
+      const auto lock = std::lock_guard<std::mutex>(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next = blocks;
+    }
+  };
+
+  // If a thread cannot be started, the threads that did start do its share
+  auto pool = std::vector<std::thread>();
+  try {
+    for (size_t i = 1; i < threads; i++) {
+      pool.emplace_back(worker);
+    }
+  } catch (const std::system_error& /* unused */) {
+  }
+
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  if (error) {
+    _hashes.clear();
+    std::rethrow_exception(error);
+  }
+
+  // Hash the levels above the split level.  An error leaves the hashes
+  // invalid here too.
+  try {
+    HashStream w(suite);
+    for (auto level = split_level + 1; level <= root_level; level++) {
+      const auto first = (uint64_t(1) << level) - 1;
+      const auto step = uint64_t(2) << level;
+      for (auto i = first; i < width.val; i += step) {
+        hash_node(w, NodeIndex{ static_cast<uint32_t>(i) }, width, hash_size);
+      }
+    }
+  } catch (...) {
+    _hashes.clear();
+    throw;
+  }
+
+  _is_dirty.assign(width.val, false);
+}
+
+bool
+TreeKEMPublicKey::hashes_valid() const
 {
-  for (auto& node : nodes) {
-    node.hash.resize(0);
+  return !nodes.empty() &&
+         _hashes.size() == nodes.size() * suite.get().digest.hash_size();
+}
+
+void
+TreeKEMPublicKey::mark_dirty(NodeIndex index)
+{
+  // If the hashes are not valid, every node is already out of date
+  if (!hashes_valid()) {
+    return;
+  }
+
+  if (_is_dirty.size() < nodes.size()) {
+    _is_dirty.resize(nodes.size(), false);
   }
+
+  if (_is_dirty[index.val]) {
+    return;
+  }
+
+  _is_dirty[index.val] = true;
+  _dirty.push_back(index);
+}
+
+void
+TreeKEMPublicKey::clear_hash_all()
+{
+  _hashes.clear();
+  _dirty.clear();
+  _is_dirty.clear();
 }
 
 void
 TreeKEMPublicKey::clear_hash_path(LeafIndex index)
 {
-  auto dp = tree_math::dirpath(NodeIndex(index), NodeCount(size()));
-  node_at(NodeIndex(index)).hash.resize(0);
+  auto dp = tree_math::DirpathRange(NodeIndex(index), NodeCount(size()));
+  mark_dirty(NodeIndex(index));
   for (auto n : dp) {
-    node_at(n).hash.resize(0);
+    mark_dirty(n);
   }
 }
 
-bytes
-TreeKEMPublicKey::get_hash(NodeIndex index)
+bool
+TreeKEMPublicKey::resolutions_valid() const
+{
+  return _res_ranges.size() == nodes.size();
+}
+
+NodeSpan
+TreeKEMPublicKey::resolution(NodeIndex index) const
 {
-  if (!node_at(index).hash.empty()) {
-    return node_at(index).hash;
+  if (!resolutions_valid()) {
+    throw InvalidParameterError("Resolution index not built");
   }
 
-  if (tree_math::level(index) == 0) {
-    node_at(index).set_leaf_hash(suite, index);
-    return node_at(index).hash;
+  const auto& range = _res_ranges.at(index.val);
+  const auto* begin = _res_pool.data() + range.offset;
+  return { begin, begin + range.size };
+}
+
+// The resolution of a node that is not blank is the node and its unmerged
+// leaves.  That of a blank parent is made of its children's resolutions, so
+// they must be up to date.
+void
+TreeKEMPublicKey::set_resolution(NodeIndex index, NodeCount width)
+{
+  const auto offset = _res_pool.size();
+  const auto& node = nodes[index.val].node;
+  if (node.has_value()) {
+    _res_pool.push_back(index);
+    const auto* parent = std::get_if<ParentNode>(&node.value().node);
+    if (parent != nullptr) {
+      for (auto leaf : parent->unmerged_leaves) {
+        _res_pool.push_back(NodeIndex(leaf));
+      }
+    }
+  } else if (tree_math::level(index) > 0) {
+    const auto left = _res_ranges[tree_math::left(index).val];
+    const auto right = _res_ranges[tree_math::right(index, width).val];
+
+    // Capacity is reserved first, so that copying within the pool does not
+    // reallocate it from under the copy
+    _res_pool.reserve(offset + left.size + right.size);
+    for (uint32_t i = 0; i < left.size; i++) {
+      _res_pool.push_back(_res_pool[left.offset + i]);
+    }
+    for (uint32_t i = 0; i < right.size; i++) {
+      _res_pool.push_back(_res_pool[right.offset + i]);
+    }
+  }
+
+  auto& range = _res_ranges[index.val];
+  _res_live -= range.size;
+  range = { static_cast<uint32_t>(offset),
+            static_cast<uint32_t>(_res_pool.size() - offset) };
+  _res_live += range.size;
+}
+
+// Only a leaf and its ancestors are affected by a change to the leaf's path
+void
+TreeKEMPublicKey::update_resolutions(LeafIndex index)
+{
+  if (!resolutions_valid()) {
+    return;
+  }
+
+  const auto width = NodeCount(static_cast<uint32_t>(nodes.size()));
+  set_resolution(NodeIndex(index), width);
+  for (auto n : tree_math::DirpathRange(NodeIndex(index), width)) {
+    set_resolution(n, width);
+  }
+
+  // Keep the space left behind by old resolutions in proportion
+  if (_res_pool.size() > 2 * _res_live + nodes.size()) {
+    compact_resolutions();
+  }
+}
+
+void
+TreeKEMPublicKey::rebuild_resolutions()
+{
+  const auto width = NodeCount(static_cast<uint32_t>(nodes.size()));
+  _res_ranges.assign(width.val, { 0, 0 });
+  _res_pool.clear();
+  _res_live = 0;
+
+  // Nodes on level L are at indices (2^L - 1) + k * 2^(L+1)
+  const auto root_level = tree_math::level(tree_math::root(width));
+  for (uint32_t level = 0; level <= root_level; level++) {
+    const auto first = (uint64_t(1) << level) - 1;
+    const auto step = uint64_t(2) << level;
+    for (auto i = first; i < width.val; i += step) {
+      set_resolution(NodeIndex{ static_cast<uint32_t>(i) }, width);
+    }
+  }
+}
+
+void
+TreeKEMPublicKey::compact_resolutions()
+{
+  auto pool = std::vector<NodeIndex>();
+  pool.reserve(_res_live);
+  for (auto& range : _res_ranges) {
+    const auto offset = static_cast<uint32_t>(pool.size());
+    const auto begin = _res_pool.begin() + range.offset;
+    pool.insert(pool.end(), begin, begin + range.size);
+    range.offset = offset;
+  }
+
+  _res_pool = std::move(pool);
+}
+
+size_t
+TreeKEMPublicKey::BytesHash::operator()(const bytes& data) const
+{
+  const auto* chars = reinterpret_cast<const char*>(data.data());
+  return std::hash<std::string_view>()(std::string_view(chars, data.size()));
+}
+
+bool
+TreeKEMPublicKey::leaf_index_valid() const
+{
+  return _leaf_index_width == nodes.size();
+}
+
+void
+TreeKEMPublicKey::index_leaf(LeafIndex index)
+{
+  const auto& node = node_at(index);
+  if (!leaf_index_valid() || !node.node.has_value()) {
+    return;
+  }
+
+  const auto& kp = node.key_package();
+  _kp_index.insert({ kp.hash(), index });
+  _identity_index.insert({ kp.credential.identity(), index });
+}
+
+// Several leaves may share a key, so only the entry for this leaf is erased
+template<typename Map>
+static void
+erase_leaf(Map& index, const bytes& key, LeafIndex leaf)
+{
+  auto [begin, end] = index.equal_range(key);
+  for (auto it = begin; it != end; ++it) {
+    if (it->second == leaf) {
+      index.erase(it);
+      return;
+    }
+  }
+}
+
+void
+TreeKEMPublicKey::unindex_leaf(LeafIndex index)
+{
+  const auto& node = node_at(index);
+  if (!leaf_index_valid() || !node.node.has_value()) {
+    return;
   }
 
-  auto lh = get_hash(tree_math::left(index));
-  auto rh = get_hash(tree_math::right(index, NodeCount(size())));
-  node_at(index).set_parent_hash(suite, index, lh, rh);
-  return node_at(index).hash;
+  const auto& kp = node.key_package();
+  erase_leaf(_kp_index, kp.hash(), index);
+  erase_leaf(_identity_index, kp.credential.identity(), index);
+}
+
+void
+TreeKEMPublicKey::rebuild_leaf_index()
+{
+  _kp_index.clear();
+  _identity_index.clear();
+  _leaf_index_width = nodes.size();
+  for (LeafIndex i{ 0 }; i < size(); i.val++) {
+    index_leaf(i);
+  }
 }
 
 } // namespace mls
@@ -16,8 +16,12 @@ TEST_CASE("Basic Credential")
 
   const auto& basic = cred.get<BasicCredential>();
   REQUIRE(basic.identity == user_id);
+  REQUIRE(cred.identity() == user_id);
 }
 
+// Certificates are not supported in an insecure simulation build, since the
+// simulated signature groups cannot use a certificate's real public key
+#if !defined(MLSPP_INSECURE_SIMULATION)
 TEST_CASE("X509 Credential Depth 2")
 {
   // Chain is of depth 2
@@ -45,6 +49,7 @@ TEST_CASE("X509 Credential Depth 2")
 
   auto x509 = cred.get<X509Credential>();
   CHECK(x509.der_chain == der_in);
+  CHECK(cred.identity() == leaf_der);
 }
 
 TEST_CASE("X509 Credential Depth 2 Marshal/Unmarshal")
@@ -104,3 +109,19 @@ TEST_CASE("X509 Credential Depth 1 Marshal/Unmarshal")
   auto x509 = unmarshaled.get<X509Credential>();
   CHECK(x509.der_chain == der_in);
 }
+#else
+TEST_CASE("X509 Credential Unsupported")
+{
+  const auto leaf_der =
+    from_hex("3081de308191a0030201020211008ab6ec20f45f128ecf9e05d912b5296d30050"
+             "6032b65703000301e170d3230303932333034353632375a170d32303039323430"
+             "34353632375a3000302a300506032b6570032100fa09d9259d7402e96146229a0"
+             "acbba85fd3f9d025981bce36a2e8d0e7d2302bba320301e300e0603551d0f0101"
+             "ff0404030202a4300c0603551d130101ff04023000300506032b6570034100305"
+             "a1a8c9a1eb85eaf36326ce66aab57bfe62713d2387e00f6af91fe86dffa6fefda"
+             "89868e0c280163e33876260a5e8524c39ee592427cad3e99a5539ceae903");
+
+  std::vector<X509Credential::CertData> der_in{ { leaf_der } };
+  REQUIRE_THROWS_AS(Credential::x509(der_in), std::runtime_error);
+}
+#endif // !defined(MLSPP_INSECURE_SIMULATION)
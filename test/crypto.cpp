@@ -4,9 +4,13 @@
 #include "test_vectors.h"
 
 #include <string>
+#include <type_traits>
 
 using namespace mls;
 
+// The simulated groups in an insecure simulation build do not reproduce the
+// real algorithms' outputs, so the interop vectors do not apply
+#if !defined(MLSPP_INSECURE_SIMULATION)
 TEST_CASE("Crypto Interop")
 {
   const auto& tv = TestLoader<CryptoTestVectors>::get();
@@ -28,6 +32,7 @@ TEST_CASE("Crypto Interop")
     REQUIRE(hpke_plaintext == tv.hpke_plaintext);
   }
 }
+#endif // !defined(MLSPP_INSECURE_SIMULATION)
 
 TEST_CASE("Basic HPKE")
 {
@@ -109,3 +114,146 @@ TEST_CASE("Signature Key Serializion")
     REQUIRE(gX2 == gX);
   }
 }
+
+TEST_CASE("Secret Bytes")
+{
+  auto data = from_hex("000102030405060708090a0b0c0d0e0f");
+  auto secret = secret_bytes(data);
+  REQUIRE(secret.size() == data.size());
+  REQUIRE(bytes(secret) == data);
+  REQUIRE(secret == data);
+
+  auto copy = secret;
+  REQUIRE(copy == secret);
+
+  copy.clear();
+  REQUIRE(copy.empty());
+  REQUIRE(copy != secret);
+
+  // Moving a secret clears the source
+  auto moved_from = secret;
+  auto moved = std::move(moved_from);
+  REQUIRE(moved == secret);
+  REQUIRE(moved_from.empty()); // NOLINT(bugprone-use-after-move)
+
+  moved_from = secret;
+  copy = std::move(moved_from);
+  REQUIRE(copy == secret);
+  REQUIRE(moved_from.empty()); // NOLINT(bugprone-use-after-move)
+
+  // Shrinking zeroizes the dropped bytes, so growing again exposes zeros
+  auto resized = secret;
+  resized.resize(4);
+  REQUIRE(resized == from_hex("00010203"));
+  resized.resize(6);
+  REQUIRE(resized == from_hex("000102030000"));
+  REQUIRE_THROWS_AS(resized.resize(secret_bytes::max_size + 1),
+                    std::invalid_argument);
+
+  // Heap copies are only made explicitly
+  static_assert(!std::is_convertible_v<secret_bytes, bytes>);
+
+  // Every suite's hash output fits, but longer values do not
+  for (auto suite_id : all_supported_suites) {
+    auto suite = CipherSuite{ suite_id };
+    REQUIRE(suite.get().digest.hash_size() <= secret_bytes::max_size);
+    REQUIRE(suite.get().hpke.kdf.hash_size() <= secret_bytes::max_size);
+  }
+
+  REQUIRE(secret_bytes(bytes(secret_bytes::max_size, 0xA0)).size() ==
+          secret_bytes::max_size);
+  REQUIRE_THROWS_AS(secret_bytes(bytes(secret_bytes::max_size + 1, 0xA0)),
+                    std::invalid_argument);
+}
+
+TEST_CASE("Parsed Key Reuse")
+{
+  for (auto suite_id : all_supported_suites) {
+    auto suite = CipherSuite{ suite_id };
+    auto a = SignaturePrivateKey::generate(suite);
+    auto b = SignaturePrivateKey::generate(suite);
+
+    auto message = from_hex("01020304");
+    auto signature = a.sign(suite, message);
+
+    // Copies share the parsed key
+    auto pub = a.public_key;
+    REQUIRE(pub.verify(suite, message, signature));
+    REQUIRE(pub.verify(suite, message, signature));
+
+    // Changing the key data causes it to be parsed again
+    pub.data = b.public_key.data;
+    REQUIRE_FALSE(pub.verify(suite, message, signature));
+    REQUIRE(pub.verify(suite, message, b.sign(suite, message)));
+
+    // Assigning a whole private key replaces its parsed key
+    auto priv = a;
+    REQUIRE(a.public_key.verify(suite, message, priv.sign(suite, message)));
+    priv = b;
+    REQUIRE(b.public_key.verify(suite, message, priv.sign(suite, message)));
+
+    // So does changing its data in place, or decoding into it
+    priv.data = a.data;
+    REQUIRE(a.public_key.verify(suite, message, priv.sign(suite, message)));
+    tls::unmarshal(tls::marshal(b), priv);
+    REQUIRE(b.public_key.verify(suite, message, priv.sign(suite, message)));
+
+    auto hpke_a = HPKEPrivateKey::generate(suite);
+    auto hpke_b = HPKEPrivateKey::generate(suite);
+    auto hpke_priv = hpke_a;
+    auto ct = hpke_b.public_key.encrypt(suite, {}, message);
+    REQUIRE_THROWS(hpke_priv.decrypt(suite, {}, ct));
+    hpke_priv.data = hpke_b.data;
+    REQUIRE(hpke_priv.decrypt(suite, {}, ct) == message);
+  }
+}
+
+TEST_CASE("KDF Labels")
+{
+  // One length byte, then "mls10 " and the label
+  REQUIRE(KDFLabel::tree.encoded() == from_hex("0a6d6c7331302074726565"));
+  REQUIRE(KDFLabel("tree").encoded() == KDFLabel::tree.encoded());
+  REQUIRE_THROWS_AS(KDFLabel(std::string(250, 'a')), InvalidParameterError);
+
+  // Derivations through an expander match the one-shot derivations
+  auto suite = CipherSuite{ CipherSuite::ID::P256_AES128GCM_SHA256_P256 };
+  auto secret = bytes(32, 0xA0);
+  auto context = from_hex("00010203");
+  auto expander = suite.expander(secret);
+  REQUIRE(expander.expand_with_label(KDFLabel::path, context, 16) ==
+          suite.expand_with_label(secret, KDFLabel::path, context, 16));
+  REQUIRE(expander.derive_secret(KDFLabel::init, context) ==
+          suite.derive_secret(secret, KDFLabel::init, context));
+
+  // String literals still convert to labels
+  REQUIRE(suite.expand_with_label(secret, "path", context, 16) ==
+          suite.expand_with_label(secret, KDFLabel::path, context, 16));
+  REQUIRE(expander.derive_secret("init", context) ==
+          suite.derive_secret(secret, KDFLabel::init, context));
+}
+
+TEST_CASE("Hash Stream")
+{
+  auto suite = CipherSuite{ CipherSuite::ID::X25519_AES128GCM_SHA256_Ed25519 };
+  auto prefix = from_hex("00010203");
+  auto data = std::vector<tls::opaque<2>>{ { bytes(0x100, 0xA0) },
+                                           { from_hex("0405") } };
+
+  tls::ostream w;
+  w.write_raw(prefix);
+  tls::vector<4>::encode(w, data);
+
+  HashStream hash(suite);
+  hash.stream().write_raw(prefix);
+  tls::vector<4>::encode(hash.stream(), data);
+  REQUIRE(hash.digest() == suite.get().digest.hash(w.bytes()));
+
+  // A stream can be reused after its digest is written out
+  HashStream reused(suite);
+  auto out = bytes(suite.get().digest.hash_size());
+  for (const auto& input : { prefix, w.bytes() }) {
+    reused.stream().write_raw(input);
+    reused.digest_into(out.data());
+    REQUIRE(out == suite.get().digest.hash(input));
+  }
+}
@@ -69,3 +69,26 @@ TEST_CASE("Key Schedule Interop")
     }
   }
 }
+
+TEST_CASE("Sender Data AEAD")
+{
+  const auto suite = CipherSuite{ CipherSuite::ID::P256_AES128GCM_SHA256_P256 };
+  const auto key_size = suite.get().hpke.aead.key_size();
+  const auto nonce = bytes(suite.get().hpke.aead.nonce_size(), 0);
+  const auto aad = bytes{ 0, 1, 2 };
+  const auto pt = bytes{ 3, 4, 5 };
+
+  auto epoch = KeyScheduleEpoch::create(
+    suite, LeafCount{ 2 }, random_bytes(key_size), {});
+  auto ct = epoch.seal_sender_data(nonce, aad, pt);
+  REQUIRE(epoch.open_sender_data(nonce, aad, ct) == pt);
+
+  // A new key replaces the cached context
+  auto other = epoch;
+  epoch.sender_data_key = random_bytes(key_size);
+  CHECK_THROWS(epoch.open_sender_data(nonce, aad, ct));
+
+  auto ct2 = epoch.seal_sender_data(nonce, aad, pt);
+  CHECK(ct2 != ct);
+  CHECK(other.open_sender_data(nonce, aad, ct) == pt);
+}
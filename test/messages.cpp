@@ -53,6 +53,9 @@ TEST_CASE("Extensions")
   REQUIRE(ph0 == ph1);
 }
 
+// The simulated groups in an insecure simulation build do not reproduce the
+// real algorithms' outputs, so the interop vectors do not apply
+#if !defined(MLSPP_INSECURE_SIMULATION)
 TEST_CASE("Messages Interop")
 {
   const auto& tv = TestLoader<MessagesTestVectors>::get();
@@ -148,3 +151,31 @@ TEST_CASE("Messages Interop")
     tls_round_trip(tc.ciphertext, ciphertext, true);
   }
 }
+#endif // !defined(MLSPP_INSECURE_SIMULATION)
+
+TEST_CASE("MLSCiphertext Header")
+{
+  auto group_id = bytes{ 0, 1, 2, 3 };
+  auto random = bytes(32, 0xA0);
+  auto ciphertext = MLSCiphertext{
+    group_id, 0x0102030405060708, ContentType::application, random, random,
+    random,   random,
+  };
+  auto encoded = tls::marshal(ciphertext);
+
+  auto header = MLSCiphertextHeader::peek(encoded);
+  REQUIRE(header.group_id_data == encoded.data() + 1);
+  REQUIRE(header.has_group_id(group_id));
+  REQUIRE_FALSE(header.has_group_id(bytes{ 0, 1, 2 }));
+  REQUIRE(header.epoch == ciphertext.epoch);
+  REQUIRE(header.content_type == ContentType::application);
+
+  // Only the header needs to be present
+  auto header_size = 1 + group_id.size() + 8 + 1;
+  REQUIRE(MLSCiphertextHeader::peek(encoded.data(), header_size).epoch ==
+          ciphertext.epoch);
+  REQUIRE_THROWS_AS(MLSCiphertextHeader::peek(encoded.data(), header_size - 1),
+                    tls::ReadError);
+  REQUIRE_THROWS_AS(MLSCiphertextHeader::peek(encoded.data(), 3),
+                    tls::ReadError);
+}
@@ -1,6 +1,7 @@
 #include "test_vectors.h"
 #include <doctest/doctest.h>
 #include <hpke/random.h>
+#include <mls/messages.h>
 #include <mls/session.h>
 
 using namespace mls;
@@ -131,6 +132,71 @@ TEST_CASE_FIXTURE(SessionTest, "Two-Person Session Creation")
   broadcast_add();
 }
 
+TEST_CASE_FIXTURE(SessionTest, "Segmented Application Messages")
+{
+  broadcast_add();
+  broadcast_add();
+
+  for (const auto size : { 16, 4096 }) {
+    auto plaintext = bytes(size, 0xa0);
+    auto message = sessions[0].protect_segments(plaintext);
+
+    auto encoded = bytes{};
+    for (const auto& segment : message.segments()) {
+      encoded.insert(encoded.end(), segment.data, segment.data + segment.size);
+    }
+
+    REQUIRE(encoded.size() == message.size());
+    REQUIRE(sessions[1].unprotect(encoded) == plaintext);
+  }
+}
+
+TEST_CASE_FIXTURE(SessionTest, "Framed Application Messages")
+{
+  broadcast_add();
+  broadcast_add();
+
+  // Send two messages over a stream that splits them at arbitrary points
+  auto plaintext1 = bytes(100, 0xa1);
+  auto plaintext2 = bytes(200, 0xa2);
+  auto stream =
+    sessions[0].protect(plaintext1) + sessions[0].protect(plaintext2);
+
+  auto decoder = tls::frame_decoder(tls::frame_layout::of<MLSCiphertext>());
+  auto received = std::vector<bytes>();
+  for (size_t start = 0; start < stream.size(); start += 37) {
+    auto end = std::min(start + 37, stream.size());
+    decoder.push(bytes(stream.begin() + start, stream.begin() + end));
+    while (auto frame = decoder.next()) {
+      received.push_back(sessions[1].unprotect(frame.value()));
+    }
+  }
+
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0] == plaintext1);
+  REQUIRE(received[1] == plaintext2);
+}
+
+TEST_CASE_FIXTURE(SessionTest, "Ciphertext Screening")
+{
+  broadcast_add();
+  broadcast_add();
+
+  auto encrypted = sessions[0].protect(bytes{ 0, 1, 2, 3 });
+  auto header = MLSCiphertextHeader::peek(encrypted);
+  REQUIRE(header.has_group_id(sessions[1].group_id()));
+  REQUIRE(header.epoch == sessions[1].current_epoch());
+
+  // Messages for another group or an unknown epoch are rejected
+  auto wrong_group = encrypted;
+  wrong_group[1] ^= 0xff;
+  REQUIRE_THROWS_AS(sessions[1].unprotect(wrong_group), ProtocolError);
+
+  auto wrong_epoch = encrypted;
+  wrong_epoch[1 + group_id.size() + 7] ^= 0xff;
+  REQUIRE_THROWS_AS(sessions[1].unprotect(wrong_epoch), MissingStateError);
+}
+
 TEST_CASE_FIXTURE(SessionTest, "Full-Size Session Creation")
 {
   for (int i = 0; i < group_size - 1; i += 1) {
@@ -164,6 +230,23 @@ TEST_CASE_FIXTURE(RunningSessionTest, "Update within Session")
   }
 }
 
+TEST_CASE_FIXTURE(RunningSessionTest, "Bounded Session History")
+{
+  auto old_message = sessions[0].protect(bytes{ 0, 1, 2, 3 });
+  auto old_epoch = sessions[0].current_epoch();
+  for (auto& session : sessions) {
+    session.history_limit(1);
+  }
+
+  auto update = sessions[0].update();
+  broadcast(update);
+  auto welcome_commit = sessions[0].commit();
+  broadcast(std::get<1>(welcome_commit));
+  check(old_epoch);
+
+  REQUIRE_THROWS_AS(sessions[1].unprotect(old_message), MissingStateError);
+}
+
 TEST_CASE_FIXTURE(RunningSessionTest, "Remove within Session")
 {
   for (int i = group_size - 1; i > 0; i -= 1) {
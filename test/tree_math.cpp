@@ -73,6 +73,22 @@ TEST_CASE_FIXTURE(TreeMathTest, "Tree Math")
 
   SUBCASE("Copath") { matrix_test(size_scope(tree_math::copath), tv.copath); }
 
+  SUBCASE("Path Ranges")
+  {
+    for (uint32_t i = 0; i < width.val; ++i) {
+      const auto x = NodeIndex{ i };
+      const auto dirpath = tree_math::DirpathRange(x, width);
+      const auto copath = tree_math::CopathRange(x, width);
+
+      REQUIRE(std::vector<NodeIndex>(dirpath.begin(), dirpath.end()) ==
+              tv.dirpath[i].nodes);
+      REQUIRE(std::vector<NodeIndex>(copath.begin(), copath.end()) ==
+              tv.copath[i].nodes);
+      REQUIRE(dirpath.size() == tv.dirpath[i].nodes.size());
+      REQUIRE(copath.empty() == tv.copath[i].nodes.empty());
+    }
+  }
+
   SUBCASE("Ancestor")
   {
     for (uint32_t l = 0; l < tv.n_leaves.val - 1; ++l) {
@@ -84,3 +100,16 @@ TEST_CASE_FIXTURE(TreeMathTest, "Tree Math")
     }
   }
 }
+
+// The index calculus can be evaluated at compile time
+static_assert(tree_math::level(NodeIndex{ 0x07 }) == 3);
+static_assert(tree_math::root(NodeCount{ 11 }).val == 0x07);
+static_assert(tree_math::left(NodeIndex{ 0x03 }).val == 0x01);
+static_assert(tree_math::right(NodeIndex{ 0x07 }, NodeCount{ 11 }).val == 0x09);
+static_assert(tree_math::parent(NodeIndex{ 0x0a }, NodeCount{ 11 }).val ==
+              0x09);
+static_assert(tree_math::sibling(NodeIndex{ 0x03 }, NodeCount{ 11 }).val ==
+              0x09);
+static_assert(tree_math::ancestor(LeafIndex{ 1 }, LeafIndex{ 4 }).val == 0x07);
+static_assert(tree_math::DirpathRange(NodeIndex{ 0 }, NodeCount{ 11 }).size() ==
+              3);
@@ -64,20 +64,21 @@ TEST_CASE_FIXTURE(TreeKEMTest, "Optional node hashes")
   auto child_hash = bytes{ 0, 1, 2, 3, 4 };
 
   auto parent = ParentNode{ init_priv.public_key, {}, {} };
-  auto opt_parent = OptionalNode{ Node{ parent }, {} };
-  REQUIRE_THROWS_AS(opt_parent.set_leaf_hash(suite, node_index),
+  auto opt_parent = OptionalNode{ Node{ parent } };
+  REQUIRE_THROWS_AS(opt_parent.hash_leaf(suite, node_index),
                     std::bad_variant_access);
 
-  opt_parent.set_parent_hash(suite, node_index, child_hash, child_hash);
-  REQUIRE_FALSE(opt_parent.hash.empty());
+  auto parent_hash =
+    opt_parent.hash_parent(suite, node_index, child_hash, child_hash);
+  REQUIRE_FALSE(parent_hash.empty());
 
-  auto opt_leaf = OptionalNode{ Node{ kp }, {} };
+  auto opt_leaf = OptionalNode{ Node{ kp } };
   REQUIRE_THROWS_AS(
-    opt_leaf.set_parent_hash(suite, node_index, child_hash, child_hash),
+    opt_leaf.hash_parent(suite, node_index, child_hash, child_hash),
     std::bad_variant_access);
 
-  opt_leaf.set_leaf_hash(suite, node_index);
-  REQUIRE_FALSE(opt_leaf.hash.empty());
+  auto leaf_hash = opt_leaf.hash_leaf(suite, node_index);
+  REQUIRE_FALSE(leaf_hash.empty());
 }
 
 TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Private Key")
@@ -200,6 +201,234 @@ TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Public Key")
   REQUIRE(root_resolution == pub.resolve(root));
 }
 
+// The tree hash as defined, computed recursively one node at a time
+static bytes
+reference_tree_hash(const TreeKEMPublicKey& pub, NodeIndex index)
+{
+  const auto& node = pub.node_at(index);
+  if (tree_math::level(index) == 0) {
+    return node.hash_leaf(pub.suite, index);
+  }
+
+  auto width = NodeCount(pub.size());
+  auto lh = reference_tree_hash(pub, tree_math::left(index));
+  auto rh = reference_tree_hash(pub, tree_math::right(index, width));
+  return node.hash_parent(pub.suite, index, lh, rh);
+}
+
+TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Public Key hashes")
+{
+  // A size that is not a power of two, so that some right children are more
+  // than one level below their parents
+  const auto size = LeafCount{ 11 };
+  const auto removed = LeafIndex{ 4 };
+
+  auto pub = TreeKEMPublicKey{ suite };
+  for (uint32_t i = 0; i < size.val; i++) {
+    auto [init_priv, sig_priv, kp] = new_key_package();
+    silence_unused(init_priv);
+    silence_unused(sig_priv);
+    pub.add_leaf(kp);
+  }
+
+  const auto root = tree_math::root(NodeCount(size));
+  pub.set_hash_all();
+  REQUIRE(pub.root_hash() == reference_tree_hash(pub, root));
+
+  // After a change, only the changed path is recomputed, with the same result.
+  // Until then, the root hash is out of date.
+  pub.blank_path(removed);
+  REQUIRE_THROWS_AS(pub.root_hash(), InvalidParameterError);
+  pub.set_hash_all();
+  REQUIRE(pub.root_hash() == reference_tree_hash(pub, root));
+
+  // Growing the tree, then truncating it, changes the shape of its right edge
+  for (uint32_t i = 0; i < 2; i++) {
+    auto [init_priv, sig_priv, kp] = new_key_package();
+    silence_unused(init_priv);
+    silence_unused(sig_priv);
+    pub.add_leaf(kp);
+  }
+
+  const auto grown_root = tree_math::root(NodeCount(LeafCount{ size.val + 1 }));
+  pub.set_hash_all();
+  REQUIRE(pub.root_hash() == reference_tree_hash(pub, grown_root));
+
+  pub.blank_path(LeafIndex{ size.val });
+  pub.truncate();
+  REQUIRE(pub.size() == size);
+  pub.set_hash_all();
+  REQUIRE(pub.root_hash() == reference_tree_hash(pub, root));
+
+  // A decoded tree has no hashes until they are all computed
+  auto decoded = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+  decoded.suite = suite;
+  REQUIRE_THROWS_AS(decoded.root_hash(), InvalidParameterError);
+  decoded.set_hash_all();
+  REQUIRE(decoded.root_hash() == pub.root_hash());
+}
+
+TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Public Key parallel hashes")
+{
+  // Enough leaves for several subtrees per thread, with blanks on the right
+  // edge so that the last subtree is partial
+  const auto size = LeafCount{ 150 };
+
+  auto pub = TreeKEMPublicKey{ suite };
+  for (uint32_t i = 0; i < size.val; i++) {
+    auto [init_priv, sig_priv, kp] = new_key_package();
+    silence_unused(init_priv);
+    silence_unused(sig_priv);
+    pub.add_leaf(kp);
+  }
+
+  pub.blank_path(LeafIndex{ 17 });
+  pub.blank_path(LeafIndex{ size.val - 2 });
+
+  auto sequential = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+  sequential.suite = suite;
+  sequential.set_hash_all();
+
+  const auto defaults = tree_hash_options();
+  REQUIRE(defaults.threads == 1);
+  REQUIRE_THROWS_AS(set_tree_hash_options({ 0, 1 }), InvalidParameterError);
+
+  // Restore the defaults even if a check fails, so that other tests are not
+  // affected
+  struct RestoreOptions
+  {
+    TreeHashOptions options;
+    ~RestoreOptions() { set_tree_hash_options(options); }
+  } restore{ defaults };
+
+  for (auto threads : { 2, 3, 8 }) {
+    set_tree_hash_options({ size_t(threads), 1 });
+
+    auto parallel = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+    parallel.suite = suite;
+    parallel.set_hash_all();
+    CHECK(parallel.root_hash() == sequential.root_hash());
+  }
+
+  // A malformed node above the split level leaves the hashes invalid
+  auto malformed = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+  malformed.suite = suite;
+  malformed.node_at(tree_math::root(NodeCount(size))).node =
+    Node{ pub.key_package(LeafIndex{ 0 }).value() };
+  REQUIRE_THROWS(malformed.set_hash_all());
+  REQUIRE_THROWS_AS(malformed.root_hash(), InvalidParameterError);
+
+  const auto root = tree_math::root(NodeCount(size));
+  REQUIRE(sequential.root_hash() == reference_tree_hash(sequential, root));
+}
+
+TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Public Key resolution index")
+{
+  auto pub = TreeKEMPublicKey{ suite };
+  auto sig_privs = std::vector<SignaturePrivateKey>{};
+
+  // A decoded copy has no index, so it computes resolutions from scratch
+  const auto check_resolutions = [&]() {
+    const auto fresh = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+    for (uint32_t i = 0; i < pub.nodes.size(); i++) {
+      const auto n = NodeIndex{ i };
+      REQUIRE(pub.resolve(n) == fresh.resolve(n));
+    }
+  };
+
+  for (uint32_t i = 0; i < 11; i++) {
+    auto [init_priv, sig_priv, kp] = new_key_package();
+    silence_unused(init_priv);
+    sig_privs.push_back(sig_priv);
+    pub.add_leaf(kp);
+    check_resolutions();
+
+    // Leave unmerged leaves behind on some of the parents
+    if (i % 3 == 1) {
+      const auto from = LeafIndex{ i - 1 };
+      auto [priv, path] = pub.encap(
+        from, { uint8_t(i) }, random_bytes(32), sig_privs[from.val], {});
+      silence_unused(priv);
+      pub.merge(from, path);
+      check_resolutions();
+    }
+  }
+
+  // Blank some paths, then the right edge, so that the tree shrinks
+  for (auto i : { 3U, 10U, 9U, 8U }) {
+    pub.blank_path(LeafIndex{ i });
+    check_resolutions();
+  }
+
+  pub.truncate();
+  REQUIRE(pub.size() == LeafCount{ 8 });
+  check_resolutions();
+
+  // Fill the gaps left by the blanked leaves
+  auto [init_priv, sig_priv, kp] = new_key_package();
+  silence_unused(init_priv);
+  silence_unused(sig_priv);
+  REQUIRE(pub.add_leaf(kp) == LeafIndex{ 3 });
+  check_resolutions();
+}
+
+TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Public Key leaf index")
+{
+  auto pub = TreeKEMPublicKey{ suite };
+  auto kps = std::vector<KeyPackage>{};
+  for (uint8_t i = 0; i < 6; i++) {
+    // Leaves 4 and 5 share an identity with leaves 0 and 1
+    auto init_priv = HPKEPrivateKey::generate(suite);
+    auto sig_priv = SignaturePrivateKey::generate(suite);
+    auto cred = Credential::basic({ uint8_t(i % 4) }, sig_priv.public_key);
+    kps.emplace_back(suite, init_priv.public_key, cred, sig_priv);
+    REQUIRE(pub.add_leaf(kps.back()) == LeafIndex{ i });
+  }
+
+  // A decoded copy has no index, so it scans the leaves
+  const auto check_find = [&]() {
+    const auto fresh = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+    for (const auto& kp : kps) {
+      REQUIRE(pub.find(kp) == fresh.find(kp));
+    }
+
+    for (uint8_t id = 0; id < 5; id++) {
+      const auto identity = bytes{ id };
+      REQUIRE(pub.find_by_identity(identity) ==
+              fresh.find_by_identity(identity));
+    }
+  };
+
+  check_find();
+  REQUIRE(pub.find(kps[3]) == LeafIndex{ 3 });
+  REQUIRE(pub.find_by_identity({ 1 }) == LeafIndex{ 1 });
+  REQUIRE_FALSE(pub.find_by_identity({ 4 }).has_value());
+
+  pub.blank_path(LeafIndex{ 1 });
+  check_find();
+  REQUIRE_FALSE(pub.find(kps[1]).has_value());
+  REQUIRE(pub.find_by_identity({ 1 }) == LeafIndex{ 5 });
+
+  pub.update_leaf(LeafIndex{ 0 }, kps[1]);
+  check_find();
+  REQUIRE(pub.find(kps[1]) == LeafIndex{ 0 });
+  REQUIRE_FALSE(pub.find(kps[0]).has_value());
+  REQUIRE(pub.find_by_identity({ 0 }) == LeafIndex{ 4 });
+
+  pub.blank_path(LeafIndex{ 5 });
+  pub.truncate();
+  check_find();
+
+  // The non-const lookups index a decoded tree
+  auto decoded = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+  decoded.suite = suite;
+  REQUIRE(decoded.find(kps[4]) == LeafIndex{ 4 });
+  REQUIRE(decoded.find_by_identity({ 1 }) == LeafIndex{ 0 });
+  REQUIRE(decoded.add_leaf(kps[0]) == LeafIndex{ 1 });
+  REQUIRE(decoded.find(kps[0]) == LeafIndex{ 1 });
+  REQUIRE(decoded.find_by_identity({ 0 }) == LeafIndex{ 1 });
+}
+
 TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM encap/decap")
 {
   const auto size = LeafCount{ 10 };
@@ -250,15 +479,32 @@ TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM encap/decap")
     REQUIRE(privs[i + 1].consistent(privs[i]));
     REQUIRE(privs[i + 1].consistent(pub));
 
-    // Other members update via decap()
+    // Other members update via decap().  The first one decaps against a copy
+    // of the tree that has been through the wire, as a joiner's tree has, so
+    // it has no resolution index.  The second decaps against the same copy
+    // once it has been hashed, which builds the index.
+    auto received = tls::get<TreeKEMPublicKey>(tls::marshal(pub));
+    received.suite = suite;
+    REQUIRE_FALSE(received.resolutions_valid());
+    REQUIRE_THROWS_AS(received.resolution(NodeIndex{ 0 }),
+                      InvalidParameterError);
+
+    auto hashed = received;
+    hashed.set_hash_all();
+    REQUIRE(hashed.resolutions_valid());
+
     for (uint32_t j = 0; j < i; j++) {
-      privs[j].decap(adder, pub, context, path);
+      const auto& tree = (j == 0) ? received : (j == 1) ? hashed : pub;
+      privs[j].decap(adder, tree, context, path);
       REQUIRE(privs[j].consistent(privs[i]));
       REQUIRE(privs[j].consistent(pub));
     }
   }
 }
 
+// The simulated groups in an insecure simulation build do not reproduce the
+// real algorithms' outputs, so the interop vectors do not apply
+#if !defined(MLSPP_INSECURE_SIMULATION)
 TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Interop")
 {
   for (size_t i = 0; i < tv.cases.size(); ++i) {
@@ -293,3 +539,4 @@ TEST_CASE_FIXTURE(TreeKEMTest, "TreeKEM Interop")
     }
   }
 }
+#endif // !defined(MLSPP_INSECURE_SIMULATION)